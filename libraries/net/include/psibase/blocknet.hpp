@@ -2,6 +2,7 @@
 
 #include <psibase/ForkDb.hpp>
 #include <psibase/Socket.hpp>
+#include <psibase/message_serializer.hpp>
 #include <psibase/net_base.hpp>
 #include <psio/finally.hpp>
 #include <psio/reflect.hpp>
@@ -12,6 +13,8 @@
 #include <chrono>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -281,12 +284,20 @@ namespace psibase::net
       std::chrono::milliseconds _timeout        = std::chrono::seconds(3);
       std::chrono::milliseconds _block_interval = std::chrono::seconds(1);
 
-      bool _trx_loop_running = false;
+      bool _trx_loop_running   = false;
+      bool _fork_switch_queued = false;
+      // The number of queued transactions applied before
+      // yielding to other work on the io_context
+      static constexpr std::uint32_t max_transaction_batch = 32;
 
       std::vector<std::unique_ptr<peer_connection>> _peers;
 
       std::shared_ptr<ProducerMulticastSocket> prods_socket;
 
+      // The most recently sent block. A new block is usually sent to all
+      // peers, one after another, so they can share the serialized message.
+      std::optional<std::pair<Checksum256, serialized_message<BlockMessage>>> _last_block_message;
+
       loggers::common_logger logger;
 
       using message_type = std::variant<HelloRequest,
@@ -866,9 +877,14 @@ namespace psibase::net
       {
          if (_state == producer_state::leader)
          {
-            if (auto trx = chain().nextTransaction())
+            // Everything in the batch goes into the current block,
+            // because the block cannot end until we return to the
+            // io_context.
+            auto trxs = chain().nextTransactions(max_transaction_batch);
+            if (!trxs.empty())
             {
-               chain().pushTransaction(std::move(*trx));
+               for (auto& trx : trxs)
+                  chain().pushTransaction(std::move(trx));
                boost::asio::post(_ioctx, [this] { process_transactions(); });
             }
             else
@@ -914,9 +930,14 @@ namespace psibase::net
             auto next_block_id = chain().get_block_id(state.last_sent.num() + 1);
             assert(next_block_id != Checksum256());
             state.last_sent = {next_block_id, state.last_sent.num() + 1};
-            auto next_block = chain().get(next_block_id);
+            if (!_last_block_message || _last_block_message->first != next_block_id)
+            {
+               auto next_block = chain().get(next_block_id);
+               _last_block_message.emplace(
+                   next_block_id, network().serialize_shared(BlockMessage{std::move(next_block)}));
+            }
 
-            network().async_send(peer.id, BlockMessage{next_block}, send_handler(peer));
+            network().async_send(peer.id, _last_block_message->second, send_handler(peer));
             peer.sending = true;
             consensus().post_send_block(peer.id, state.last_sent.id());
          }
@@ -1037,7 +1058,7 @@ namespace psibase::net
       // This should be called after any operation that might change the head block.
       void switch_fork()
       {
-         chain().async_switch_fork(
+         bool complete = chain().async_switch_fork(
              [this](const BlockInfo& head)
              {
                 {
@@ -1049,6 +1070,18 @@ namespace psibase::net
                 do_gc();
              },
              [this](BlockHeaderState* state) { consensus().on_accept_block(state); });
+         // A long fork switch is split up, so that messages and timers
+         // can be handled between the pieces.
+         if (!complete && !_fork_switch_queued)
+         {
+            _fork_switch_queued = true;
+            boost::asio::post(_ioctx,
+                              [this]
+                              {
+                                 _fork_switch_queued = false;
+                                 switch_fork();
+                              });
+         }
       }
 
       void do_gc()
@@ -1290,7 +1323,7 @@ namespace psibase::net
 
       void recv(peer_id origin, const WasmProducerMessage& msg)
       {
-         chain().recvMessage(*prods_socket, msg.data);
+         chain().recvMessage(*prods_socket, origin, msg.data);
       }
 
       // Default implementations
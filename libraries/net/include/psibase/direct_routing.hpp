@@ -52,11 +52,13 @@ namespace psibase::net
       {
          std::sort(dest.begin(), dest.end());
          dest.erase(std::unique(dest.begin(), dest.end()), dest.end());
-         auto serialized_message = this->serialize_message(msg);
+         // Serialize once and share the buffer between all the peers
+         shared_message serialized =
+             std::make_shared<const std::vector<char>>(this->serialize_message(msg));
          for (auto peer : dest)
          {
             PSIBASE_LOG(peers().logger(peer), debug) << "Sending message: " << msg.to_string();
-            peers().async_send(peer, serialized_message, [](const std::error_code& ec) {});
+            peers().async_send(peer, serialized, [](const std::error_code& ec) {});
          }
       }
       template <typename Msg>
@@ -2,10 +2,18 @@
 
 #include <psibase/SignedMessage.hpp>
 #include <psibase/block.hpp>
+#include <psibase/net_base.hpp>
 
+#include <psio/finally.hpp>
 #include <psio/fracpack.hpp>
 #include <psio/stream.hpp>
 
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
 
 namespace psibase::net
@@ -13,6 +21,22 @@ namespace psibase::net
    template <typename T, typename Derived>
    concept has_recv = requires(Derived& d, const T& msg) { d.consensus().recv(0, msg); };
 
+   // A message that has already been serialized. Sending it to several
+   // peers shares the buffer instead of serializing it for each peer.
+   template <typename Msg>
+   struct serialized_message
+   {
+      using message_type = std::conditional_t<NeedsSignature<Msg>, SignedMessage<Msg>, Msg>;
+      shared_message data;
+
+      message_type unpack() const
+      {
+         return psio::from_frac<message_type>(
+             std::span<const char>{data->data() + 1, data->size() - 1});
+      }
+      std::string to_string() const { return unpack().to_string(); }
+   };
+
    template <typename Derived>
    struct message_serializer
    {
@@ -26,30 +50,100 @@ namespace psibase::net
          psio::to_frac(msg, s);
          return result;
       }
+      // Signs the message type followed by the packed message, which is
+      // size bytes starting at msg. The byte before msg is temporarily
+      // replaced with the type, so that the message does not need to be copied.
+      template <NeedsSignature Msg>
+      std::vector<char> sign_packed_message(char* msg, std::uint32_t size, const Claim& claim)
+      {
+         static_assert(Msg::type < 128);
+         char          saved = msg[-1];
+         psio::finally restore{[&] { msg[-1] = saved; }};
+         msg[-1] = Msg::type;
+         return static_cast<Derived*>(this)->chain().sign({msg - 1, size + 1}, claim);
+      }
       template <NeedsSignature Msg>
       SignedMessage<Msg> sign_message(const Msg& msg)
       {
-         auto  raw   = serialize_unsigned_message(msg);
-         Claim claim = msg.signer;
-         auto  sig   = static_cast<Derived*>(this)->chain().sign({raw.data(), raw.size()}, claim);
-         return {msg, sig};
+         // The size prefix of the shared_view_ptr is the byte before the message
+         psio::shared_view_ptr<Msg> data{msg};
+
+         auto sig = sign_packed_message<Msg>(data.data(), data.size(), msg.signer);
+         return {std::move(data), std::move(sig)};
       }
-      template <typename Msg>
+      // Packs the message directly into the frame and signs it there
+      template <NeedsSignature Msg>
       std::vector<char> serialize_signed_message(const Msg& msg)
       {
-         // TODO: avoid serializing the message twice
-         return serialize_unsigned_message(sign_message(msg));
+         // The frame is the type followed by SignedMessage<Msg>, which is
+         // - the offset of data
+         // - the offset of signature
+         // - data: the size of the message and the packed message
+         // - signature: the size of the signature and the signature
+         constexpr std::uint32_t data_pos = 1 + 4 + 4 + 4;
+
+         // Enough for the signatures from the built-in provers. Larger
+         // signatures still work, but require reallocating the frame.
+         constexpr std::uint32_t signature_reserve = 4 + 128;
+
+         std::uint32_t size = psio::fracpack_size(msg);
+         // An empty message would be packed with a zero offset and no size prefix
+         assert(size != 0);
+         std::vector<char> result;
+         result.reserve(data_pos + size + signature_reserve);
+         result.resize(data_pos + size);
+         result[0] = SignedMessage<Msg>::type;
+
+         std::uint32_t data_offset = data_pos - 1 - 4;
+         std::memcpy(result.data() + 1, &data_offset, 4);
+         std::memcpy(result.data() + data_pos - 4, &size, 4);
+         psio::fast_buf_stream s(result.data() + data_pos, size);
+         psio::to_frac(msg, s);
+
+         auto sig = sign_packed_message<Msg>(result.data() + data_pos, size, msg.signer);
+
+         std::uint32_t sig_offset = sig.empty() ? 0 : data_pos + size - 1 - 4;
+         std::memcpy(result.data() + 1 + 4, &sig_offset, 4);
+         if (!sig.empty())
+         {
+            std::uint32_t sig_size = sig.size();
+            result.insert(result.end(), reinterpret_cast<const char*>(&sig_size),
+                          reinterpret_cast<const char*>(&sig_size) + 4);
+            result.insert(result.end(), sig.begin(), sig.end());
+         }
+         return result;
+      }
+      template <typename Msg>
+      static serialized_message<Msg> serialize_shared(const Msg& msg)
+      {
+         return {std::make_shared<const std::vector<char>>(serialize_unsigned_message(msg))};
+      }
+      template <NeedsSignature Msg>
+      serialized_message<Msg> serialize_shared(const Msg& msg)
+      {
+         return {std::make_shared<const std::vector<char>>(serialize_signed_message(msg))};
+      }
+      template <typename Msg>
+      static serialized_message<Msg> serialize_shared(const serialized_message<Msg>& msg)
+      {
+         return msg;
       }
       template <typename Msg>
       auto serialize_message(const Msg& msg)
       {
          return serialize_unsigned_message(msg);
       }
+      template <typename Msg>
+      shared_message serialize_message(const serialized_message<Msg>& msg)
+      {
+         return msg.data;
+      }
       template <NeedsSignature Msg>
       auto serialize_message(const Msg& msg)
       {
          return serialize_signed_message(msg);
       }
-      auto serialize_message(const std::vector<char>& msg) { return msg; }
+      auto           serialize_message(const std::vector<char>& msg) { return msg; }
+      shared_message serialize_message(const shared_message& msg) { return msg; }
    };
 }  // namespace psibase::net
@@ -83,6 +83,12 @@ namespace psibase::net
          }
          send(peer->second, msg);
       }
+      // Peers in the mock network exchange unpacked messages
+      template <typename Msg>
+      void async_send(peer_id id, const serialized_message<Msg>& msg)
+      {
+         async_send(id, msg.unpack());
+      }
       template <typename Msg, typename F>
       void async_send(peer_id id, const Msg& msg, F&& f)
       {
@@ -2,6 +2,9 @@
 
 #include <psibase/AccountNumber.hpp>
 
+#include <memory>
+#include <vector>
+
 namespace psibase::net
 {
    using producer_id                          = AccountNumber;
@@ -11,4 +14,7 @@ namespace psibase::net
    // which requires binding it to the TLS session, which we don't have
    // access to because we're behind a proxy...
    using NodeId = std::uint64_t;
+   // A serialized message. It is immutable, so the same buffer
+   // can be written to any number of connections.
+   using shared_message = std::shared_ptr<const std::vector<char>>;
 }  // namespace psibase::net
@@ -35,9 +35,9 @@ namespace psibase::net
       connection_base() {}
       using read_handler  = std::function<void(const std::error_code&, std::vector<char>&&)>;
       using write_handler = std::function<void(const std::error_code&)>;
-      virtual void async_write(std::vector<char>&&, write_handler) = 0;
-      virtual void async_read(read_handler)                        = 0;
-      virtual void close(close_code)                               = 0;
+      virtual void async_write(shared_message, write_handler) = 0;
+      virtual void async_read(read_handler)                   = 0;
+      virtual void close(close_code)                          = 0;
       // Information for display
       virtual std::string endpoint() const { return ""; }
       //
@@ -65,7 +65,13 @@ namespace psibase::net
          async_recv(id, std::move(conn));
       }
       template <typename F>
-      void async_send(peer_id id, const std::vector<char>& msg, F&& f)
+      void async_send(peer_id id, std::vector<char>&& msg, F&& f)
+      {
+         async_send(id, std::make_shared<const std::vector<char>>(std::move(msg)),
+                    std::forward<F>(f));
+      }
+      template <typename F>
+      void async_send(peer_id id, shared_message msg, F&& f)
       {
          auto iter = _connections.find(id);
          if (iter == _connections.end())
@@ -73,7 +79,7 @@ namespace psibase::net
             throw std::runtime_error("unknown peer");
          }
          iter->second->async_write(
-             std::vector<char>(msg),
+             std::move(msg),
              [this, &ctx = _ctx, f = std::forward<F>(f)](const std::error_code& ec) mutable
              { boost::asio::dispatch(ctx, [this, f = std::move(f), ec]() mutable { f(ec); }); });
       }
@@ -81,7 +87,9 @@ namespace psibase::net
       {
          PSIBASE_LOG(conn->logger, debug)
              << "Sending message: " << network().message_to_string(msg);
-         conn->async_write(network().serialize_message(msg), [](const std::error_code&) {});
+         conn->async_write(
+             std::make_shared<const std::vector<char>>(network().serialize_message(msg)),
+             [](const std::error_code&) {});
       }
       void async_recv(peer_id id, std::shared_ptr<connection_base>&& c)
       {
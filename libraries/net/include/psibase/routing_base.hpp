@@ -134,6 +134,12 @@ namespace psibase::net
          handle_message(msg, [&](const auto& m) { result = message_to_string(m); });
          return result;
       }
+      std::string message_to_string(const shared_message& msg) { return message_to_string(*msg); }
+      template <typename Msg>
+      std::string message_to_string(const serialized_message<Msg>& msg)
+      {
+         return message_to_string(msg.unpack());
+      }
       template <typename T, typename F>
       void handle_message_impl(psio::input_stream& s, F&& f)
       {
@@ -182,11 +182,25 @@ namespace psibase::net
       struct DeferredMessage
       {
          using MessageKey = std::tuple<peer_id, Checksum256>;
-         peer_id           peer;
-         Checksum256       blockid;
-         std::vector<char> message;
-         friend auto       operator<=>(const DeferredMessage&, const DeferredMessage&) = default;
-         friend auto       operator<=>(const DeferredMessage& lhs, const peer_id& rhs)
+         peer_id        peer;
+         Checksum256    blockid;
+         shared_message message;
+         // The message is compared by content, so that the same message
+         // deferred twice is only stored once, even if it was serialized
+         // separately each time.
+         friend std::strong_ordering operator<=>(const DeferredMessage& lhs,
+                                                 const DeferredMessage& rhs)
+         {
+            if (auto cmp = MessageKey{lhs.peer, lhs.blockid} <=> MessageKey{rhs.peer, rhs.blockid};
+                cmp != 0)
+               return cmp;
+            return *lhs.message <=> *rhs.message;
+         }
+         friend bool operator==(const DeferredMessage& lhs, const DeferredMessage& rhs)
+         {
+            return (lhs <=> rhs) == 0;
+         }
+         friend auto operator<=>(const DeferredMessage& lhs, const peer_id& rhs)
          {
             return lhs.peer <=> rhs;
          }
@@ -208,37 +222,44 @@ namespace psibase::net
          routerId = std::uniform_int_distribution<RouterId>()(rng);
       }
 
+      // Messages that go to several peers are serialized once, and all
+      // the peers share the buffer.
       template <typename Msg>
       void multicast(const Msg& msg)
       {
+         auto serialized = this->serialize_shared(msg);
          for (const auto& [peer, _] : neighborTable)
          {
-            async_send(peer, msg);
+            async_send(peer, serialized);
          }
       }
       template <typename Msg>
       void multicast(const Checksum256& id, const Msg& msg)
       {
+         auto serialized = this->serialize_shared(msg);
          for (const auto& [peer, _] : neighborTable)
          {
-            send_after_block(peer, id, msg);
+            send_after_block(peer, id, serialized);
          }
       }
+      // Each producer gets its own envelope, but the message inside
+      // is only serialized once.
       template <typename Msg>
       void multicast_producers(const Checksum256& id, const Msg& msg)
       {
+         auto data = this->serialize_message(msg);
          for (const auto& [producer, selected] : selectedRoutes)
          {
-            send_after_block(selected.peer, id,
-                             RoutingEnvelope{producer, this->serialize_message(msg)});
+            send_after_block(selected.peer, id, RoutingEnvelope{producer, data});
          }
       }
       template <typename Msg>
       void multicast_producers(const Msg& msg)
       {
+         auto data = this->serialize_message(msg);
          for (const auto& [producer, selected] : selectedRoutes)
          {
-            sendto(producer, msg);
+            async_send(selected.peer, RoutingEnvelope{producer, data});
          }
       }
       template <typename Msg>
@@ -270,7 +291,7 @@ namespace psibase::net
          }
          else
          {
-            deferredMessages.insert({peer, blockid, this->serialize_message(msg)});
+            deferredMessages.insert({peer, blockid, this->serialize_shared(msg).data});
          }
       }
       void on_peer_block(peer_id peer, const Checksum256& blockid)
@@ -9,7 +9,7 @@ namespace
    struct connection : connection_base
    {
       explicit connection(boost::asio::io_context& ctx) : ctx(ctx) {}
-      virtual void async_write(std::vector<char>&& data, write_handler handler)
+      virtual void async_write(psibase::net::shared_message message, write_handler handler)
       {
          if (!is_open())
          {
@@ -17,6 +17,7 @@ namespace
                               { handler(make_error_code(boost::asio::error::eof)); });
             return;
          }
+         std::vector<char> data(*message);
          if (peer->pending_read)
          {
             boost::asio::post(
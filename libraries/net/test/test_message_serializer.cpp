@@ -0,0 +1,96 @@
+#include <psibase/bft.hpp>
+#include <psibase/blocknet.hpp>
+#include <psibase/cft.hpp>
+#include <psibase/message_serializer.hpp>
+
+#include <catch2/catch_all.hpp>
+
+#include <numeric>
+
+using namespace psibase;
+using namespace psibase::net;
+
+namespace
+{
+   struct mock_chain
+   {
+      // Reads all the data, but is cheap enough that the benchmarks
+      // measure serialization rather than signing
+      std::vector<char> sign(std::span<char> data, const Claim&)
+      {
+         std::vector<char> result(64);
+         std::iota(result.begin(), result.end(),
+                   std::accumulate(data.begin(), data.end(), char(0)));
+         return result;
+      }
+   };
+
+   struct serializer : message_serializer<serializer>
+   {
+      mock_chain& chain() { return _chain; }
+
+      // The previous implementation, which packed the message once to sign it,
+      // again into SignedMessage::data, and then copied it into the frame
+      template <typename Msg>
+      std::vector<char> serialize_signed_message_separately(const Msg& msg)
+      {
+         auto raw = serialize_unsigned_message(msg);
+         auto sig = chain().sign({raw.data(), raw.size()}, msg.signer);
+         return serialize_unsigned_message(SignedMessage<Msg>{msg, sig});
+      }
+
+      mock_chain _chain;
+   };
+
+   Claim makeClaim()
+   {
+      return {AccountNumber{"verify-sig"}, std::vector<char>(91, 'k')};
+   }
+
+   Checksum256 makeId()
+   {
+      Checksum256 result;
+      std::iota(result.begin(), result.end(), std::uint8_t(1));
+      return result;
+   }
+
+   template <typename Msg>
+   void checkSerialization(const Msg& msg)
+   {
+      serializer s;
+      auto       expected = s.serialize_signed_message_separately(msg);
+      CHECK(s.serialize_signed_message(msg) == expected);
+      CHECK(s.serialize_unsigned_message(s.sign_message(msg)) == expected);
+   }
+
+   template <typename Msg>
+   void benchmarkSerialization(const std::string& name, const Msg& msg)
+   {
+      serializer s;
+      BENCHMARK(name + " (separate passes)")
+      {
+         return s.serialize_signed_message_separately(msg);
+      };
+      BENCHMARK(name)
+      {
+         return s.serialize_signed_message(msg);
+      };
+   }
+}  // namespace
+
+TEST_CASE("signed message serialization", "[serializer]")
+{
+   AccountNumber prod{"prod"};
+   auto          prepare = PrepareMessage{makeId(), prod, makeClaim()};
+   auto          commit  = CommitMessage{makeId(), prod, makeClaim()};
+   auto          wasm    = WasmProducerMessage{std::vector<char>(4096, 'x'), prod, makeClaim()};
+
+   checkSerialization(prepare);
+   checkSerialization(commit);
+   checkSerialization(wasm);
+   checkSerialization(WasmProducerMessage{{}, prod, {}});
+
+   benchmarkSerialization("prepare", prepare);
+   benchmarkSerialization("commit", commit);
+   benchmarkSerialization("wasm producer message", wasm);
+}
@@ -64,6 +64,7 @@ struct mock_consensus
    }
 
    bool validate_message(const message1&) { return true; }
+   bool peer_has_block(peer_id, const Checksum256&) { return has_block; }
 
    void connect(peer_id id) {}
    void disconnect(peer_id id) {}
@@ -81,7 +82,8 @@ struct mock_consensus
    }
    std::vector<message1> _recv_queue;
    AccountNumber         producer;
-   std::string           name = "<anonymous node>";
+   std::string           name      = "<anonymous node>";
+   bool                  has_block = true;
    //
    std::optional<std::set<AccountNumber>> active_producers;
 };
@@ -198,6 +200,55 @@ TEST_CASE("producers only")
    CHECK(node3.consume() == std::vector{message1{42}});
 }
 
+// Keeps the messages that are written to it
+struct recording_connection : connection_base
+{
+   virtual void async_write(shared_message message, write_handler handler)
+   {
+      messages.push_back(std::move(message));
+   }
+   virtual void                async_read(read_handler handler) {}
+   virtual void                close(close_code) {}
+   std::vector<shared_message> messages;
+};
+
+TEST_CASE("multicast shares the serialized message")
+{
+   boost::asio::io_context                            ctx;
+   TestNode                                           node1(ctx, "a");
+   std::vector<std::shared_ptr<recording_connection>> conns;
+   std::vector<peer_id>                               ids;
+   for (int i = 0; i < 5; ++i)
+   {
+      conns.push_back(std::make_shared<recording_connection>());
+      node1.peers().add_connection(conns.back());
+   }
+   for (const auto& [id, _] : node1.connections())
+      ids.push_back(id);
+   auto sent = [&]
+   {
+      std::set<const std::vector<char>*> result;
+      for (const auto& conn : conns)
+      {
+         REQUIRE(!conn->messages.empty());
+         result.insert(conn->messages.back().get());
+      }
+      return result;
+   };
+
+   node1.network().multicast(message1{42});
+   CHECK(sent().size() == 1);
+
+   // Messages that wait for a block are shared too
+   Checksum256 id{};
+   node1.consensus().has_block = false;
+   node1.network().multicast(id, message1{7});
+   for (auto peer : ids)
+      node1.network().on_peer_block(peer, id);
+   CHECK(sent().size() == 1);
+   CHECK((*conns.front()->messages.back())[0] == message1::type);
+}
+
 struct ConsoleLog
 {
    std::string type   = "console";
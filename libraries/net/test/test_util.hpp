@@ -124,6 +124,7 @@ struct TestNode
       node.chain().getLogger().add_attribute("Host", attr);
       node.consensus().logger.add_attribute("Host", attr);
       node.network().logger.add_attribute("Host", attr);
+      node.chain().setSharedState(db.sharedState);
       node.set_producer_id(producer);
       node.load_producers();
       WasmMemoryCache::instance().init(*system);
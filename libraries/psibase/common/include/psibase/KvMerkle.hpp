@@ -43,11 +43,27 @@ namespace psibase
       // An empty stack is a special case which represents the initial state.
       std::vector<Checksum256>   stack;
       std::vector<unsigned char> current_key;
-      Checksum256                root() &&;
-      void                       push(const Item& item);
-      void               push_hash(std::span<const unsigned char> key, const Checksum256& value);
+      // The length of current_key in bits. This is only less than
+      // 8 * current_key.size() after push_subtree.
+      std::size_t current_bits = 0;
+      Checksum256 root() &&;
+      void        push(const Item& item);
+      void        push_hash(std::span<const unsigned char> key, const Checksum256& value);
+      // Pushes the node for all keys that begin with the first `bits` bits
+      // of prefix. The remaining bits of prefix must be 0. Keys that begin
+      // with the prefix must not be pushed afterwards.
+      //
+      // The root of a KvMerkle that only holds keys that begin with a prefix
+      // is the node for the prefix, so this can combine parts of the keyspace
+      // that were hashed separately.
+      void               push_subtree(std::span<const unsigned char> prefix,
+                                      std::size_t                    bits,
+                                      const Checksum256&             value);
       static Checksum256 combine(const Checksum256& lhs, const Checksum256& rhs);
       void               pop_n(std::size_t n);
+
+     private:
+      void push_node(std::span<const unsigned char> key, std::size_t bits, const Checksum256& value);
    };
 
    void KvMerkle::Item::fromStream(auto& stream)
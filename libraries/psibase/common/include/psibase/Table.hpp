@@ -5,7 +5,9 @@
 #include <compare>
 #include <concepts>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <memory>
 #include <psibase/api.hpp>
 #include <psibase/blob.hpp>
 #include <psibase/serviceState.hpp>
@@ -99,6 +101,21 @@ namespace psibase
       }
       kv_raw_iterator& operator++()
       {
+         if (page && page_pos + 1 < page->rows.size())
+         {
+            ++page_pos;
+            auto current = page->key(page_pos);
+            key.assign(current.begin(), current.end());
+            return *this;
+         }
+         if (page && !is_end)
+         {
+            // Load the next page after the last row of this one
+            key.push_back(0);
+            if (!scan(page_rows))
+               set(-1);
+            return *this;
+         }
          if (!is_end)
             key.push_back(0);
          set(raw::kvGreaterEqual(db, key.data(), key.size(), prefix_size));
@@ -112,6 +129,7 @@ namespace psibase
       }
       kv_raw_iterator& operator--()
       {
+         page.reset();
          set(is_end ? raw::kvMax(db, key.data(), key.size())
                     : raw::kvLessThan(db, key.data(), key.size(), prefix_size));
          return *this;
@@ -126,10 +144,18 @@ namespace psibase
       void read(C& c) const
       {
          //static_assert(C::value_type is char, unsigned char, or std::byte);
-         int sz = raw::kvGet(db, key.data(), key.size());
-         check(sz >= 0, "no such key");
-         c.resize(sz);
-         raw::getResult(c.data(), c.size(), 0);
+         if (page)
+         {
+            auto value = page->value(page_pos);
+            c.assign(value.begin(), value.end());
+         }
+         else
+         {
+            int sz = raw::kvGet(db, key.data(), key.size());
+            check(sz >= 0, "no such key");
+            c.resize(sz);
+            raw::getResult(c.data(), c.size(), 0);
+         }
          if (is_secondary)
          {
             int sz = raw::kvGet(db, c.data(), c.size());
@@ -157,9 +183,24 @@ namespace psibase
       {
          return (lhs <=> rhs) == std::weak_ordering::equivalent;
       }
-      void move_to(int res) { set(res); }
+      // Reads up to rows entries, starting at the current position, with
+      // a single host call. Increments and reads are served from the
+      // buffered rows, and another page is loaded when they run out.
+      //
+      // The buffered rows are not updated if the table is modified.
+      void prefetch(std::uint32_t rows)
+      {
+         if (is_end || rows == 0 || !scan(rows))
+            page.reset();
+      }
+      void move_to(int res)
+      {
+         page.reset();
+         set(res);
+      }
       void move_to(std::span<const char> keyWithoutPrefix)
       {
+         page.reset();
          key.resize(prefix_size);
          key.insert(key.end(), keyWithoutPrefix.begin(), keyWithoutPrefix.end());
          is_end = !keyWithoutPrefix.empty();
@@ -170,6 +211,82 @@ namespace psibase
       }
 
      private:
+      // The result of kvScan. Rows refer to the keys and values in buffer.
+      struct scan_page
+      {
+         struct row
+         {
+            std::uint32_t key_pos;
+            std::uint32_t key_size;
+            std::uint32_t value_pos;
+            std::uint32_t value_size;
+         };
+         std::vector<char> buffer;
+         std::vector<row>  rows;
+
+         std::span<const char> key(std::size_t i) const
+         {
+            return {buffer.data() + rows[i].key_pos, rows[i].key_size};
+         }
+         std::span<const char> value(std::size_t i) const
+         {
+            return {buffer.data() + rows[i].value_pos, rows[i].value_size};
+         }
+      };
+
+      // Loads rows starting at key. Returns false if there are none.
+      bool scan(std::uint32_t rows)
+      {
+         // Reuse the memory of the current page, unless a copy of
+         // this iterator is still reading it
+         auto result = std::move(page);
+         if (!result || result.use_count() != 1)
+            result = std::make_shared<scan_page>();
+         auto& buffer = result->buffer;
+         if (buffer.size() < 16 * 1024)
+            buffer.resize(16 * 1024);
+         result->rows.clear();
+
+         auto size = raw::kvScan(db, key.data(), key.size(), prefix_size, rows, buffer.data(),
+                                 buffer.size());
+         if (size != -1 && size > buffer.size())
+         {
+            // The first row does not fit
+            buffer.resize(size);
+            size = raw::kvScan(db, key.data(), key.size(), prefix_size, rows, buffer.data(),
+                               buffer.size());
+         }
+         if (size == -1)
+            return false;
+         check(size <= buffer.size(), "kvScan: row does not fit");
+
+         std::uint32_t pos  = 0;
+         auto          read = [&](std::uint32_t& start, std::uint32_t& len)
+         {
+            check(size - pos >= 4, "kvScan: invalid result");
+            std::memcpy(&len, buffer.data() + pos, 4);
+            pos += 4;
+            check(size - pos >= len, "kvScan: invalid result");
+            start = pos;
+            pos += len;
+         };
+         while (pos != size)
+         {
+            auto& r = result->rows.emplace_back();
+            read(r.key_pos, r.key_size);
+            read(r.value_pos, r.value_size);
+         }
+         if (result->rows.empty())
+            return false;
+         auto first = result->key(0);
+         key.assign(first.begin(), first.end());
+         is_end    = false;
+         page      = std::move(result);
+         page_pos  = 0;
+         page_rows = rows;
+         return true;
+      }
+
       void set(int sz)
       {
          if (sz >= 0)
@@ -190,6 +307,10 @@ namespace psibase
       std::size_t       prefix_size;
       bool              is_secondary = false;
       bool              is_end       = true;
+      // Rows loaded by prefetch; shared by copies of the iterator
+      std::shared_ptr<scan_page> page;
+      std::size_t                page_pos  = 0;
+      std::uint32_t              page_rows = 0;
    };
 
    /// An iterator into a [TableIndex]
@@ -298,6 +419,17 @@ namespace psibase
       /// The returned value can be passed to `moveTo`, e.g. for GraphQL cursors.
       std::span<const char> keyWithoutPrefix() const { return base.keyWithoutPrefix(); }
 
+      /// Read ahead
+      ///
+      /// This loads up to `rows` entries, starting at the current position, with
+      /// a single call to [raw::kvScan]. Moving forward and reading objects is served
+      /// from the loaded rows, and the next batch is loaded when they run out. Moving
+      /// backward or calling `moveTo` discards them.
+      ///
+      /// The loaded rows are not updated if the table is modified, so only use this
+      /// when the table will not be written while iterating.
+      void prefetch(std::uint32_t rows) { base.prefetch(rows); }
+
       /// get object
       ///
       /// This reads an object from the database. It does not cache; it returns a fresh object
@@ -601,29 +733,37 @@ namespace psibase
       {
          KeyView key_base{{prefix.data(), prefix.size()}};
          auto    buffer = psio::composite_key(key_base, k);
-         int     res    = raw::kvGet(db, buffer.data(), buffer.size());
-         if (res < 0)
-         {
-            return R{};
-         }
-         if (is_secondary)
-         {
-            buffer.resize(res);
-            raw::getResult(buffer.data(), buffer.size(), 0);
-            res = raw::kvGet(db, buffer.data(), buffer.size());
-            check(res >= 0, "primary key not found");
-         }
          if constexpr (View)
          {
+            int res = raw::kvGet(db, buffer.data(), buffer.size());
+            if (res < 0)
+            {
+               return R{};
+            }
+            if (is_secondary)
+            {
+               buffer.resize(res);
+               raw::getResult(buffer.data(), buffer.size(), 0);
+               res = raw::kvGet(db, buffer.data(), buffer.size());
+               check(res >= 0, "primary key not found");
+            }
             psio::shared_view_ptr<T> v{psio::size_tag{static_cast<std::uint32_t>(res)}};
             raw::getResult(v.data(), v.size(), 0);
             return v;
          }
          else
          {
-            buffer.resize(res);
-            raw::getResult(buffer.data(), buffer.size(), 0);
-            return psio::from_frac<T>(psio::prevalidated{buffer});
+            std::vector<char> value;
+            if (!kvGetRaw(db, buffer, value))
+            {
+               return R{};
+            }
+            if (is_secondary)
+            {
+               buffer.swap(value);
+               check(kvGetRaw(db, buffer, value), "primary key not found");
+            }
+            return psio::from_frac<T>(psio::prevalidated{std::move(value)});
          }
       }
       UniqueKvHandle    db;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <psibase/AccountNumber.hpp>
 #include <psibase/block.hpp>
 #include <psibase/check.hpp>
@@ -213,6 +214,19 @@ namespace psibase
       /// exist, returns `-1` and clears result. Use [getResult] to get result.
       PSIBASE_NATIVE(kvGet) uint32_t kvGet(KvHandle db, const char* key, uint32_t keyLen);
 
+      /// Get a key-value pair, if any, copying the value directly into dest
+      ///
+      /// If key exists, then returns the size of the value. If the value fits in
+      /// dest, it is copied there and result is cleared. Otherwise dest is not
+      /// modified and result is set to the value; use [getResult] to get it. If
+      /// key does not exist, returns `-1` and clears result.
+      PSIBASE_NATIVE(kvGetInto)
+      uint32_t kvGetInto(KvHandle    db,
+                         const char* key,
+                         uint32_t    keyLen,
+                         char*       dest,
+                         uint32_t    destSize);
+
       /// Get the first key-value pair which is greater than or equal to the provided
       /// key
       ///
@@ -223,6 +237,26 @@ namespace psibase
       PSIBASE_NATIVE(kvGreaterEqual)
       uint32_t kvGreaterEqual(KvHandle db, const char* key, uint32_t keyLen, uint32_t matchKeySize);
 
+      /// Get a batch of key-value pairs, starting at the first one which is greater
+      /// than or equal to the provided key
+      ///
+      /// Reads up to `maxRows` pairs whose first `matchKeySize` bytes match the
+      /// provided key and copies them into dest. Each pair is stored as a `u32` key
+      /// size, the key, a `u32` value size, and the value. Keys do not include the
+      /// handle's prefix. Stops early when the next pair does not fit in dest.
+      ///
+      /// Returns the number of bytes written. If the first pair does not fit, returns
+      /// its size without writing anything; the result is larger than `destSize`. If
+      /// there are no matching pairs, returns `-1`. Clears result and key.
+      PSIBASE_NATIVE(kvScan)
+      uint32_t kvScan(KvHandle    db,
+                      const char* key,
+                      uint32_t    keyLen,
+                      uint32_t    matchKeySize,
+                      uint32_t    maxRows,
+                      char*       dest,
+                      uint32_t    destSize);
+
       /// Get the key-value pair immediately-before provided key
       ///
       /// If one is found, and the first `matchKeySize` bytes of the found key
@@ -536,13 +570,36 @@ namespace psibase
       return kvGetSizeRaw(db, psio::convert_to_key(key));
    }
 
+   /// Get a key-value pair, if any, into value
+   ///
+   /// Reuses value's storage. Values that fit in it are read with a single call.
+   /// Returns false and leaves value unspecified if key does not exist. key must
+   /// not point into value.
+   inline bool kvGetRaw(KvHandle db, psio::input_stream key, std::vector<char>& value)
+   {
+      value.resize(std::max(value.capacity(), std::size_t{256}));
+      auto size = raw::kvGetInto(db, key.pos, key.remaining(), value.data(), value.size());
+      if (size == -1)
+         return false;
+      if (size > value.size())
+      {
+         value.resize(size);
+         raw::getResult(value.data(), value.size(), 0);
+      }
+      else
+      {
+         value.resize(size);
+      }
+      return true;
+   }
+
    /// Get a key-value pair, if any
    inline std::optional<std::vector<char>> kvGetRaw(KvHandle db, psio::input_stream key)
    {
-      auto size = raw::kvGet(db, key.pos, key.remaining());
-      if (size == -1)
+      std::vector<char> result;
+      if (!kvGetRaw(db, key, result))
          return std::nullopt;
-      return getResult(size);
+      return result;
    }
 
    /// Get a key-value pair, if any
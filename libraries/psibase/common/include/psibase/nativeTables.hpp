@@ -148,6 +148,8 @@ namespace psibase
       // Determines which signatures (if any) have
       // already been verified.
       preverifyTransaction,
+      // Returns a batch of transactions to apply
+      nextTransactions,
    };
 
    using NotifyKeyType = std::tuple<std::uint16_t, std::uint8_t, NotifyType>;
@@ -410,6 +410,9 @@ namespace psibase
       else
       {
          result.pageInfo.hasPreviousPage = it != rangeBegin;
+         // Queries can't modify the table, so it's safe to read ahead.
+         // One extra row is needed for hasNextPage.
+         it.prefetch(first ? std::min(*first, std::uint32_t{256}) + 1 : 256);
          for (; it != end && (!first || (*first)-- > 0); ++it)
             add_edge(it);
          result.pageInfo.hasNextPage = it != rangeEnd;
@@ -2,6 +2,8 @@
 
 #include <psibase/api.hpp>
 
+#include <algorithm>
+
 namespace
 {
    std::size_t common_prefix_bits(unsigned char lhs, unsigned char rhs)
@@ -12,42 +14,51 @@ namespace
       else
          return __builtin_clz(x) - (std::numeric_limits<unsigned>::digits - 8);
    }
+   bool get_bit(std::span<const unsigned char> key, std::size_t n)
+   {
+      return (key[n / 8] >> (7 - n % 8)) & 1;
+   }
    std::size_t common_prefix_bits(std::span<const unsigned char> lhs,
-                                  std::span<const unsigned char> rhs)
+                                  std::size_t                    lhs_bits,
+                                  std::span<const unsigned char> rhs,
+                                  std::size_t                    rhs_bits)
    {
-      auto len = std::min(lhs.size(), rhs.size());
+      auto        len    = std::min(lhs.size(), rhs.size());
+      std::size_t result = len * 8;
       for (std::size_t i = 0; i < len; ++i)
       {
          if (lhs[i] != rhs[i])
          {
-            psibase::check(lhs[i] < rhs[i], "Keys must be inserted in increasing order");
-            return i * 8 + common_prefix_bits(lhs[i], rhs[i]);
+            result = i * 8 + common_prefix_bits(lhs[i], rhs[i]);
+            break;
          }
       }
-      psibase::check(len < rhs.size(), "Keys must be inserted in increasing order");
-      return len * 8;
+      result = std::min({result, lhs_bits, rhs_bits});
+      if (result < lhs_bits && result < rhs_bits)
+         psibase::check(!get_bit(lhs, result), "Keys must be inserted in increasing order");
+      else
+         psibase::check(result == lhs_bits && result < rhs_bits,
+                        "Keys must be inserted in increasing order");
+      return result;
    }
-   std::size_t get_stack_after(std::span<const unsigned char> key, std::size_t n)
+   // The number of stack entries for bits [n, bits) of key: one for each
+   // set bit, one for each byte boundary, and one for the key itself.
+   std::size_t get_stack_after(std::span<const unsigned char> key, std::size_t bits, std::size_t n)
    {
-      std::size_t i = n / 8;
-      if (i == key.size())
+      if (n == bits)
          return 0;
-      std::size_t result = 1 + std::popcount(key[i] & (0xffu >> (n % 8)));
-      ++i;
-      for (; i != key.size(); ++i)
+      std::size_t result = 1 + (bits - 1) / 8 - n / 8;
+      unsigned    mask   = 0xffu >> (n % 8);
+      for (std::size_t i = n / 8; i != (bits + 7) / 8; ++i)
       {
-         result += 1 + std::popcount(key[i]);
+         result += std::popcount(key[i] & mask);
+         mask = 0xffu;
       }
       return result;
    }
-   std::size_t get_stack_size(std::span<const unsigned char> key)
+   std::size_t get_stack_size(std::span<const unsigned char> key, std::size_t bits)
    {
-      std::size_t result = 1 + key.size();
-      for (unsigned char b : key)
-      {
-         result += std::popcount(b);
-      }
-      return result;
+      return 1 + get_stack_after(key, bits, 0);
    }
 }  // namespace
 
@@ -117,6 +128,7 @@ namespace psibase
       auto result = stack.back();
       stack.clear();
       current_key.clear();
+      current_bits = 0;
       return result;
    }
    void KvMerkle::push(const Item& item)
@@ -125,10 +137,23 @@ namespace psibase
                 item.get_hash());
    }
    void KvMerkle::push_hash(std::span<const unsigned char> key, const Checksum256& value)
+   {
+      push_node(key, key.size() * 8, value);
+   }
+   void KvMerkle::push_subtree(std::span<const unsigned char> prefix,
+                               std::size_t                    bits,
+                               const Checksum256&             value)
+   {
+      psibase::check(prefix.size() * 8 >= bits, "Prefix is too short");
+      push_node(prefix.first((bits + 7) / 8), bits, value);
+   }
+   void KvMerkle::push_node(std::span<const unsigned char> key,
+                            std::size_t                    bits,
+                            const Checksum256&             value)
    {
       if (stack.empty())
       {
-         if (key.empty())
+         if (bits == 0)
          {
             stack.push_back(value);
             return;
@@ -138,9 +163,9 @@ namespace psibase
             stack.push_back(Checksum256{});
          }
       }
-      auto        n              = common_prefix_bits(current_key, key);
-      std::size_t bits_to_remove = get_stack_after(current_key, n);
-      std::size_t bits_to_add    = get_stack_after(key, n);
+      auto        n              = common_prefix_bits(current_key, current_bits, key, bits);
+      std::size_t bits_to_remove = get_stack_after(current_key, current_bits, n);
+      std::size_t bits_to_add    = get_stack_after(key, bits, n);
       std::size_t new_stack_size = stack.size() - bits_to_remove + bits_to_add;
       if (bits_to_remove)
          pop_n(bits_to_remove - 1);
@@ -152,8 +177,9 @@ namespace psibase
       current_key.resize(bytes_kept);
       auto new_key_part = key.subspan(bytes_kept);
       current_key.insert(current_key.end(), new_key_part.begin(), new_key_part.end());
+      current_bits = bits;
       // sanity check
-      assert(get_stack_size(current_key) == stack.size());
+      assert(get_stack_size(current_key, current_bits) == stack.size());
    }
    Checksum256 KvMerkle::combine(const Checksum256& lhs, const Checksum256& rhs)
    {
@@ -21,14 +21,24 @@ namespace psibase
       bool              needGenesisAction = false;
       bool              started           = false;
       bool              active            = false;
-      // Both of these are supersets of the actual values,
+      // All of these are supersets of the actual values,
       // as they are not reverted when a transaction fails.
       std::set<AccountNumber>     modifiedAuthAccounts;
       std::set<CodeByHashKeyType> removedCode;
+      // Compiled in the background once the block is written
+      std::set<CodeByHashKeyType> writtenCode;
 
       // Initialized on first use
       std::optional<Checksum256> verifyContextId;
 
+      // Decoded native configuration. Once any of these rows is written,
+      // caching stops for the rest of the block, because the write might
+      // be reverted.
+      bool                         configModified = false;
+      std::optional<ConfigRow>     config;
+      std::optional<WasmConfigRow> transactionWasmConfig;
+      std::optional<WasmConfigRow> proofWasmConfig;
+
       loggers::common_logger trxLogger;
 
       BlockContext(SystemContext&                  systemContext,
@@ -50,6 +60,11 @@ namespace psibase
       void      callOnBlock();
       void      callOnTransaction(const Checksum256& id, const TransactionTrace& trace);
       std::optional<SignedTransaction> callNextTransaction();
+      // Returns up to maxCount transactions. Falls back to
+      // nextTransaction if no service registered nextTransactions.
+      std::vector<SignedTransaction> callNextTransactions(std::uint32_t maxCount);
+      template <typename R>
+      R callNextTransactionImpl(NotifyType notifyType, std::vector<char> args);
       // \post The size of the result is the number of proofs in the
       // transaction. Entries that cannot be filled (including due to
       // errors) will be set to zero.
@@ -93,6 +108,16 @@ namespace psibase
 
       Checksum256 getVerifyContextId();
 
+      ConfigRow     getConfig();
+      WasmConfigRow getWasmConfig(NativeTableNum table);
+      void          onConfigWrite();
+
       psibase::BlockTime getHeadBlockTime();
    };  // BlockContext
+
+   // Returns a started BlockContext for running queries at head. The
+   // context is owned by systemContext, so that queries at the same head
+   // skip creating and starting a new block. Queries must run with
+   // DbMode::rpc(), which keeps them from writing to the block.
+   BlockContext& getQueryContext(SystemContext& systemContext, const ConstRevisionPtr& head);
 }  // namespace psibase
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <filesystem>
 #include <psibase/block.hpp>
 #include <psibase/nativeTables.hpp>
 
 namespace psibase
 {
    struct Database;
+   struct SharedDatabase;
    struct VMOptions;
 
    // Only useful for genesis
@@ -21,10 +23,29 @@ namespace psibase
       std::shared_ptr<WasmCacheImpl> impl;
 
       WasmCache(uint32_t cacheSize);
+      // Remembers the contents of the cache in dir, so that preload
+      // can compile the same modules after a restart. The list is saved
+      // periodically and when the cache is destroyed.
+      WasmCache(uint32_t cacheSize, const std::filesystem::path& dir);
       WasmCache(const WasmCache&);
       WasmCache(WasmCache&&);
       ~WasmCache();
 
+      // Compiles the modules that were in the cache when it was last saved
+      // on the background thread used by prepare, most used first, after
+      // any modules that prepare requests. Modules whose code is no longer
+      // in the database are skipped.
+      void preload(const SharedDatabase& db);
+
+      // Compiles a module on a background thread, unless it is already cached.
+      // Background compiles never evict modules that have been used.
+      void prepare(const Checksum256&        codeHash,
+                   const VMOptions&          vmOptions,
+                   std::vector<std::uint8_t> code);
+      // Looks up the code of the services at the head block and
+      // compiles it on a background thread.
+      void prepareServices(const SharedDatabase& db, std::span<const AccountNumber> services);
+
       std::vector<std::span<const char>> span() const;
    };
 
@@ -4,10 +4,11 @@
 #include <boost/log/attributes/constant.hpp>
 #include <iostream>
 #include <psibase/BlockContext.hpp>
-#include <psibase/KvMerkle.hpp>
 #include <psibase/Prover.hpp>
+#include <psibase/RecvThreadPool.hpp>
 #include <psibase/Socket.hpp>
 #include <psibase/VerifyProver.hpp>
+#include <psibase/VerifyThreadPool.hpp>
 #include <psibase/block.hpp>
 #include <psibase/db.hpp>
 #include <psibase/headerValidation.hpp>
@@ -15,7 +16,10 @@
 #include <psibase/serviceEntry.hpp>
 #include <psio/to_hex.hpp>
 
+#include <condition_variable>
+#include <mutex>
 #include <ranges>
+#include <thread>
 
 namespace psibase
 {
@@ -271,29 +275,14 @@ namespace psibase
    {
       snapshot::StateChecksum operator()()
       {
-         Database                db{sharedDatabase, revision};
-         auto                    session = db.startRead();
-         snapshot::StateChecksum result{.serviceRoot = hash(db, DbId::service),
-                                        .nativeRoot  = hash(db, DbId::native)};
+         snapshot::StateChecksum result{
+             .serviceRoot = sharedDatabase.kvMerkleRoot(revision, DbId::service, numThreads),
+             .nativeRoot  = sharedDatabase.kvMerkleRoot(revision, DbId::native, numThreads)};
          return result;
       }
-      Checksum256 hash(Database& database, DbId db)
-      {
-         KvMerkle       merkle;
-         KvMerkle::Item item{{}, {}};
-         while (true)
-         {
-            auto key = item.key();
-            auto kv  = database.kvGreaterEqualRaw(db, key, 0);
-            if (!kv)
-               return std::move(merkle).root();
-            item.from(kv->key, kv->value);
-            merkle.push(item);
-            item.nextKey();
-         }
-      }
       ConstRevisionPtr revision;
       SharedDatabase   sharedDatabase;
+      std::size_t      numThreads = std::max(std::thread::hardware_concurrency(), 1u);
    };
 
    class SnapshotLoader;
@@ -741,14 +730,19 @@ namespace psibase
       {
          // TODO: consider allowing overlapping ranges, but verify that the contents
          // are identical.
-         if (!getRanges(db)->add(std::move(low), std::move(high)))
+         if (!getRanges(db)->add(std::vector<char>(low), std::vector<char>(high)))
             abortMessage("Snapshot parts overlap");
-         Database database(systemContext->sharedDatabase, revision);
-         auto     session = database.startWrite(writer);
+         // The rows arrive sorted, so the part can be built as a separate
+         // tree and spliced in, instead of inserting the rows one at a time.
+         std::vector<Database::KVResult> items;
+         items.reserve(rows.size());
          for (const SnapshotItem& row : rows)
          {
-            database.kvPutRaw(db, row.key, row.value);
+            items.push_back({row.key, row.value});
          }
+         Database database(systemContext->sharedDatabase, revision);
+         auto     session = database.startWrite(writer);
+         database.kvReplaceRangeRaw(db, low, high, items);
          revision = database.getModifiedRevision();
       }
       bool complete() const { return serviceKeys.complete() && nativeKeys.complete(); }
@@ -777,9 +771,11 @@ namespace psibase
          std::size_t           totalSize = 0;
          {
             auto sesssion = database.startRead();
+            auto iter     = database.kvIterator(currentDb);
+            auto row      = iter.seek(currentKey, 0);
             while (totalSize < limit)
             {
-               if (auto row = database.kvGreaterEqualRaw(currentDb, currentKey, 0))
+               if (row)
                {
                   auto key   = std::vector<char>{row->key.pos, row->key.end};
                   auto value = std::vector<char>{row->value.pos, row->value.end};
@@ -801,6 +797,7 @@ namespace psibase
                   break;
                }
                currentKey.push_back(0);
+               row = iter.next();
             }
          }
          high = currentKey;
@@ -1045,10 +1042,17 @@ namespace psibase
          }
       }
 
+      // \return false if the switch stopped early because it ran past
+      // the fork switch time slice. It should be called again later to
+      // continue.
       template <typename F, typename Accept>
-      void async_switch_fork(F&& callback, Accept&& on_accept_block)
+      bool async_switch_fork(F&& callback, Accept&& on_accept_block)
       {
          auto original_head = head;
+         auto deadline      = forkSwitchTimeSlice ? std::optional{std::chrono::steady_clock::now() +
+                                                                  *forkSwitchTimeSlice}
+                                                  : std::nullopt;
+         bool complete      = true;
          while (true)
          {
             auto pos =
@@ -1077,26 +1081,44 @@ namespace psibase
                {
                   if (original_head != head)
                   {
-                     bool res = trySetHead(original_head, std::forward<Accept>(on_accept_block));
+                     auto res = trySetHead(original_head, std::forward<Accept>(on_accept_block));
                      // We were already on this fork, so we know that it's definitely good.
-                     assert(res);
+                     assert(res == ForkExecution::done);
                   }
-                  return;
+                  return true;
                }
             }
-            if (trySetHead(new_head, std::forward<Accept>(on_accept_block)))
+            auto res = trySetHead(new_head, std::forward<Accept>(on_accept_block), deadline,
+                                  original_head->order());
+            if (res == ForkExecution::paused)
+               complete = false;
+            if (res != ForkExecution::failed)
                break;
          }
          if (head != original_head)
          {
             callback(head->info);
          }
+         return complete;
       }
+      enum class ForkExecution
+      {
+         done,
+         failed,
+         paused,
+      };
+      // If a deadline is provided, execution may stop after any block that
+      // is at least as good as minOrder, leaving head between the original
+      // head and new_head.
       template <typename Accept>
-      bool trySetHead(BlockHeaderState* new_head, Accept&& on_accept_block)
+      ForkExecution trySetHead(
+          BlockHeaderState*                                    new_head,
+          Accept&&                                             on_accept_block,
+          std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt,
+          decltype(std::declval<BlockHeaderState>().order())   minOrder = {})
       {
          if (head == new_head)
-            return true;
+            return ForkExecution::done;
          if (new_head->blockNum() < head->blockNum())
          {
             if (new_head->blockNum() < commitIndex)
@@ -1124,16 +1146,21 @@ namespace psibase
             --iter;
             if (iter->second == id)
             {
-               if (execute_fork(iter, byBlocknumIndex.end(), on_accept_block))
+               auto res =
+                   execute_fork(iter, byBlocknumIndex.end(), on_accept_block, deadline, minOrder);
+               if (res == ForkExecution::done)
                {
                   head = new_head;
                   assert(!!head->revision);
-                  return true;
                }
-               else
+               else if (res == ForkExecution::paused)
                {
-                  return false;
+                  PSIBASE_LOG_CONTEXT_BLOCK(logger, head->info.header, head->blockId());
+                  PSIBASE_LOG(logger, info)
+                      << "Pausing fork switch with " << (new_head->blockNum() - head->blockNum())
+                      << " blocks remaining";
                }
+               return res;
             }
             if (iter->first <= commitIndex)
             {
@@ -1160,30 +1187,235 @@ namespace psibase
          prover.prove(BlockSignatureInfo(info), *claim);
          return std::move(*claim);
       }
-      // TODO: this can run concurrently.
-      void validateTransactionSignatures(BlockContext&           bc,
-                                         const Block&            b,
-                                         const ConstRevisionPtr& revision)
+      struct PendingProof
+      {
+         const SignedTransaction* trx;
+         std::size_t              index;
+         Checksum256              token;
+      };
+      // If bc is provided, it is used to run the preverify callbacks,
+      // which may let some proofs be skipped.
+      static std::vector<PendingProof> getPendingProofs(const Block& b, BlockContext* bc)
       {
-         BlockContext verifyBc(*systemContext, revision);
-         verifyBc.start(b.header.time);
+         std::vector<PendingProof> proofs;
          for (const auto& trx : b.transactions)
          {
             check(trx.proofs.size() == trx.transaction->claims().size(),
                   "proofs and claims must have same size");
             if (!trx.proofs.empty())
             {
-               auto verifyTokens = bc.callPreverify(trx);
+               std::vector<Checksum256> verifyTokens(trx.proofs.size());
+               if (bc)
+                  verifyTokens = bc->callPreverify(trx);
                for (std::size_t i = 0; i < trx.proofs.size(); ++i)
+                  proofs.push_back({&trx, i, verifyTokens[i]});
+            }
+         }
+         return proofs;
+      }
+      // A set of proofs that are verified by the chain thread and the
+      // threads of verifyPool. Proofs are claimed one at a time, so after
+      // a failure or cancel, the proofs that haven't started are skipped.
+      struct ProofBatch
+      {
+         ProofBatch(const ConstRevisionPtr& revision, const Block& b, std::vector<PendingProof> p)
+             : revision(revision), block(&b), proofs(std::move(p)), errors(proofs.size())
+         {
+         }
+         ConstRevisionPtr                revision;
+         const Block*                    block;
+         std::vector<PendingProof>       proofs;
+         std::vector<std::exception_ptr> errors;
+         std::mutex                      mutex;
+         std::condition_variable         cond;
+         std::size_t                     next    = 0;
+         std::size_t                     running = 0;
+         bool                            stopped = false;
+
+         std::optional<std::size_t> claim()
+         {
+            std::lock_guard l{mutex};
+            if (stopped || next == proofs.size())
+               return {};
+            ++running;
+            return next++;
+         }
+         void finish(std::size_t n, std::exception_ptr error)
+         {
+            std::lock_guard l{mutex};
+            if (error)
+            {
+               errors[n] = std::move(error);
+               stopped   = true;
+            }
+            --running;
+            cond.notify_all();
+         }
+         void work(SystemContext& sc)
+         {
+            std::optional<BlockContext> verifyBc;
+            while (auto n = claim())
+            {
+               std::exception_ptr error;
+               try
                {
+                  if (!verifyBc)
+                  {
+                     verifyBc.emplace(sc, revision);
+                     verifyBc->start(block->header.time);
+                  }
                   TransactionTrace trace;
-                  verifyBc.verifyProof(trx, trace, i, std::nullopt, nullptr, verifyTokens[i]);
+                  verifyBc->verifyProof(*proofs[*n].trx, trace, proofs[*n].index, std::nullopt,
+                                        nullptr, proofs[*n].token);
                }
+               catch (...)
+               {
+                  error = std::current_exception();
+               }
+               finish(*n, std::move(error));
+            }
+         }
+         void cancel()
+         {
+            std::lock_guard l{mutex};
+            stopped = true;
+         }
+         // \return the first failure in block order
+         std::exception_ptr wait()
+         {
+            std::unique_lock l{mutex};
+            cond.wait(l, [this] { return running == 0 && (stopped || next == proofs.size()); });
+            for (auto& e : errors)
+               if (e)
+                  return e;
+            return nullptr;
+         }
+      };
+      void setHead(const ConstRevisionPtr& revision)
+      {
+         systemContext->sharedDatabase.setHead(*writer, revision);
+         if (sharedState)
+            sharedState->releaseQueryContexts(revision);
+      }
+      // The chain thread also verifies proofs, so it counts
+      // against maxVerifyThreads. Without a SharedState to take
+      // SystemContexts from, the pool has no threads.
+      VerifyThreadPool& getVerifyPool()
+      {
+         if (!verifyPool)
+         {
+            verifyPool = std::make_unique<VerifyThreadPool>(
+                sharedState, sharedState ? maxVerifyThreads - 1 : 0);
+         }
+         return *verifyPool;
+      }
+      // Hands the proofs to at most maxThreads threads of the pool
+      std::shared_ptr<ProofBatch> startProofs(const ConstRevisionPtr&   revision,
+                                              const Block&              b,
+                                              std::vector<PendingProof> proofs,
+                                              std::size_t               maxThreads)
+      {
+         auto  batch = std::make_shared<ProofBatch>(revision, b, std::move(proofs));
+         auto& pool  = getVerifyPool();
+         auto  n     = std::min({batch->proofs.size(), pool.size(), maxThreads});
+         for (std::size_t i = 0; i < n; ++i)
+            pool.post([batch](SystemContext& sc) { batch->work(sc); });
+         return batch;
+      }
+      // Proofs are independent of each other and of the block's execution,
+      // so they are verified on several threads. Preverify callbacks use the
+      // subjective database and run first, on this thread.
+      void validateTransactionSignatures(BlockContext&           bc,
+                                         const Block&            b,
+                                         const ConstRevisionPtr& revision)
+      {
+         auto proofs = getPendingProofs(b, &bc);
+         if (proofs.empty())
+            return;
+
+         auto helpers = proofs.size() - 1;
+         auto batch   = startProofs(revision, b, std::move(proofs), helpers);
+         batch->work(*systemContext);
+         if (auto e = batch->wait())
+            std::rethrow_exception(e);
+      }
+      // Verifies the proofs of a block while the block before it
+      // is executing. The result can only be used if the previous
+      // block did not change anything that proof verification depends on.
+      struct EarlyProofCheck
+      {
+         ConstRevisionPtr            revision;
+         Checksum256                 consensusState;
+         Block                       block;
+         std::exception_ptr          error;
+         std::shared_ptr<ProofBatch> batch;
+
+         ~EarlyProofCheck()
+         {
+            // The batch refers to block
+            if (batch)
+            {
+               batch->cancel();
+               batch->wait();
+            }
+         }
+         // Verifies the remaining proofs on this thread too
+         void wait(SystemContext& sc)
+         {
+            if (batch && !error)
+            {
+               batch->work(sc);
+               error = batch->wait();
             }
          }
+      };
+      // \pre the state of prev has been set
+      std::unique_ptr<EarlyProofCheck> startEarlyProofCheck(BlockHeaderState* prev,
+                                                            BlockHeaderState* state)
+      {
+         auto result            = std::make_unique<EarlyProofCheck>();
+         result->revision       = prev->revision;
+         result->consensusState = prev->info.header.consensusState;
+         result->block          = Block(get(state->blockId())->block());
+         try
+         {
+            auto proofs = getPendingProofs(result->block, nullptr);
+            // Leave the rest of the pool for the block that is executing
+            if (!proofs.empty())
+               result->batch = startProofs(result->revision, result->block, std::move(proofs),
+                                           getVerifyPool().size() / 2);
+         }
+         catch (...)
+         {
+            result->error = std::current_exception();
+         }
+         return result;
+      }
+      // Proof verification runs the code of verify services, which is
+      // covered by consensusState, and reads these configuration rows.
+      bool sameProofEnvironment(const ConstRevisionPtr& lhs, const ConstRevisionPtr& rhs)
+      {
+         auto read = [&](const ConstRevisionPtr& revision)
+         {
+            Database db{systemContext->sharedDatabase, revision};
+            auto     session = db.startRead();
+            return std::pair{
+                psio::convert_to_frac(db.kvGetOrDefault<ConfigRow>(ConfigRow::db, ConfigRow::key())),
+                psio::convert_to_frac(db.kvGetOrDefault<WasmConfigRow>(
+                    WasmConfigRow::db, WasmConfigRow::key(proofWasmConfigTable)))};
+         };
+         return read(lhs) == read(rhs);
+      }
+      bool canUseEarlyProofCheck(const EarlyProofCheck& early, BlockHeaderState* prev)
+      {
+         return early.consensusState == prev->info.header.consensusState &&
+                sameProofEnvironment(early.revision, prev->revision);
       }
       // \pre the state of prev has been set
-      bool execute_block(BlockHeaderState* prev, BlockHeaderState* state, auto&& on_accept_block)
+      bool execute_block(BlockHeaderState* prev,
+                         BlockHeaderState* state,
+                         auto&&            on_accept_block,
+                         EarlyProofCheck*  early = nullptr)
       {
          std::error_code ec{};
          if (!state->revision)
@@ -1195,7 +1427,18 @@ namespace psibase
             {
                auto claim = validateBlockSignature(prev, state->info, blockPtr->signature());
                ctx.start(Block(blockPtr->block()));
-               validateTransactionSignatures(ctx, ctx.current, prev->revision);
+               if (early && canUseEarlyProofCheck(*early, prev))
+               {
+                  early->wait(*systemContext);
+                  if (early->error)
+                     std::rethrow_exception(early->error);
+               }
+               else
+               {
+                  if (early && early->batch)
+                     early->batch->cancel();
+                  validateTransactionSignatures(ctx, ctx.current, prev->revision);
+               }
                ctx.execAllInBlock();
                auto [newRevision, id] = ctx.writeRevision(FixedProver(blockPtr->signature()), claim,
                                                           state->getProdsAuthRevision());
@@ -1223,29 +1466,53 @@ namespace psibase
          }
          return true;
       }
-      // TODO: run this in a separate thread and make it interruptable
-      bool execute_fork(auto iter, auto end, auto&& on_accept_block)
+      // Runs on the chain thread. If the deadline passes, execution stops
+      // between blocks and async_switch_fork continues it later.
+      ForkExecution execute_fork(auto                                                 iter,
+                                 auto                                                 end,
+                                 auto&&                                               on_accept_block,
+                                 std::optional<std::chrono::steady_clock::time_point> deadline,
+                                 decltype(std::declval<BlockHeaderState>().order())   minOrder)
       {
          if (iter != end)
          {
             auto* prev = get_state(iter->second);
             assert(prev->revision);
             ++iter;
+            // Proofs of the block after the one being executed are
+            // verified in the background.
+            std::unique_ptr<EarlyProofCheck> early;
             for (; iter != end; ++iter)
             {
                BlockHeaderState* nextState = get_state(iter->second);
-               if (!execute_block(prev, nextState, on_accept_block))
+               auto              current   = std::move(early);
+               if (auto after = std::next(iter); after != end && !nextState->revision)
+               {
+                  auto* afterState = get_state(after->second);
+                  if (!afterState->revision)
+                     early = startEarlyProofCheck(prev, afterState);
+               }
+               if (!execute_block(prev, nextState, on_accept_block, current.get()))
                {
                   byBlocknumIndex.erase(iter, end);
                   blacklist_subtree(nextState);
                   head = prev;
-                  return false;
+                  return ForkExecution::failed;
                }
-               systemContext->sharedDatabase.setHead(*writer, nextState->revision);
+               setHead(nextState->revision);
                prev = nextState;
+               // Give other work a chance to run. Don't stop on a block that
+               // is worse than the original head.
+               if (deadline && std::next(iter) != end && prev->order() >= minOrder &&
+                   std::chrono::steady_clock::now() >= *deadline)
+               {
+                  byBlocknumIndex.erase(std::next(iter), end);
+                  head = prev;
+                  return ForkExecution::paused;
+               }
             }
          }
-         return true;
+         return ForkExecution::done;
       }
       LightHeaderState light_validate()
       {
@@ -1371,7 +1638,7 @@ namespace psibase
             auto     session = database.startWrite(writer);
             database.writeRevision(session, id);
          }
-         systemContext->sharedDatabase.setHead(*writer, revision);
+         setHead(revision);
          head = &pos->second;
          // Do not call commit(). It tries to step forward over blocks that
          // we don't have.
@@ -1923,7 +2190,7 @@ namespace psibase
             assert(blockContext->current.header.previous == head->blockId());
             auto [revision, id] =
                 blockContext->writeRevision(prover, *claim, head->getNextAuthRevision());
-            systemContext->sharedDatabase.setHead(*writer, revision);
+            setHead(revision);
             assert(head->blockId() == blockContext->current.header.previous);
             BlockInfo info;
             info.header  = blockContext->current.header;
@@ -2014,6 +2281,17 @@ namespace psibase
          return result;
       }
 
+      std::vector<SignedTransaction> nextTransactions(std::uint32_t maxCount)
+      {
+         auto bc = getBlockContext();
+         if (!bc || bc->needGenesisAction)
+            return {};
+         auto session = bc->db.startWrite(writer);
+         auto result  = bc->callNextTransactions(maxCount);
+         session.commit();
+         return result;
+      }
+
       void onChangeNextTransaction(auto&& fn) { dbCallbacks.nextTransaction = fn; }
       void onChangeRunQueue(auto&& fn) { dbCallbacks.runQueue = fn; }
       void onChangeHostConfig(auto&& fn) { dbCallbacks.hostConfig = fn; };
@@ -2022,27 +2300,20 @@ namespace psibase
       void onSocketOpen(auto&& fn) { dbCallbacks.socketOpen = fn; }
       void onSocketP2P(auto&& fn) { dbCallbacks.socketP2P = fn; }
 
-      void recvMessage(const Socket& sock, const std::vector<char>& data)
-      {
-         Action action{.service = proxyServiceNum,
-                       .rawData = psio::to_frac(std::tuple(sock.id, data, std::uint32_t{0}))};
+      // If set, messages are handled by the pool instead of on the calling thread
+      void setRecvThreadPool(RecvThreadPool* pool) { recvPool = pool; }
+      // If set, the pooled query contexts are released when the head changes,
+      // and proofs are verified on SystemContexts from the SharedState. This
+      // must be called before the first block is validated.
+      void setSharedState(std::shared_ptr<SharedState> state) { sharedState = std::move(state); }
 
-         // TODO: This can run concurrently
-         BlockContext     bc{*systemContext, systemContext->sharedDatabase.getHead(),
-                             systemContext->sharedDatabase.createWriter(), true};
-         TransactionTrace trace;
-         try
-         {
-            auto& atrace = bc.execAsyncExport("recv", std::move(action), trace);
-            BOOST_LOG_SCOPED_LOGGER_TAG(bc.trxLogger, "Trace", std::move(trace));
-            PSIBASE_LOG(bc.trxLogger, debug) << action.service.str() << "::recv succeeded";
-         }
-         catch (std::exception& e)
-         {
-            BOOST_LOG_SCOPED_LOGGER_TAG(bc.trxLogger, "Trace", std::move(trace));
-            PSIBASE_LOG(bc.trxLogger, warning)
-                << action.service.str() << "::recv failed: " << e.what();
-         }
+      // Messages with the same origin are handled in order
+      void recvMessage(const Socket& sock, std::int64_t origin, const std::vector<char>& data)
+      {
+         if (recvPool)
+            recvPool->push(sock.id, origin, data);
+         else
+            callRecv(*systemContext, systemContext->sharedDatabase.createWriter(), sock.id, data);
       }
 
       void setSocket(std::int32_t fd, const std::shared_ptr<Socket>& sock)
@@ -2066,6 +2337,12 @@ namespace psibase
 
       void onCommit(std::function<void(BlockHeaderState*)> fn) { onCommitFn = std::move(fn); }
 
+      // Limits how long a single call to async_switch_fork may execute blocks
+      void setForkSwitchTimeSlice(std::chrono::steady_clock::duration d)
+      {
+         forkSwitchTimeSlice = d;
+      }
+
       bool isProducing() const { return !!blockContext; }
 
       auto& getLogger() { return logger; }
@@ -2235,6 +2512,11 @@ namespace psibase
       std::chrono::microseconds                                 proofWatchdogLimit{200000};
       std::optional<BlockContext>                               blockContext;
       SystemContext*                                            systemContext = nullptr;
+      // Verifies transaction proofs. Created when it is first needed.
+      std::unique_ptr<VerifyThreadPool>                         verifyPool;
+      std::size_t                                               maxVerifyThreads =
+          std::max(std::thread::hardware_concurrency(), 1u);
+      std::optional<std::chrono::steady_clock::duration>        forkSwitchTimeSlice;
       WriterPtr                                                 writer;
       CheckedProver                                             prover;
       BlockNum                                                  commitIndex = 1;
@@ -2249,6 +2531,8 @@ namespace psibase
 
       std::function<void(BlockHeaderState*)> onCommitFn;
       DatabaseCallbacks                      dbCallbacks;
+      RecvThreadPool*                        recvPool = nullptr;
+      std::shared_ptr<SharedState>           sharedState;
 
       loggers::common_logger logger;
       loggers::common_logger blockLogger;
@@ -55,9 +55,17 @@ namespace psibase
                      eosio::vm::span<const char> value);
       void     kvRemove(uint32_t handle, eosio::vm::span<const char> key);
       uint32_t kvGet(uint32_t handle, eosio::vm::span<const char> key);
+      uint32_t kvGetInto(uint32_t                    handle,
+                         eosio::vm::span<const char> key,
+                         eosio::vm::span<char>       dest);
       uint32_t kvGreaterEqual(uint32_t                    handle,
                               eosio::vm::span<const char> key,
                               uint32_t                    matchKeySize);
+      uint32_t kvScan(uint32_t                    handle,
+                      eosio::vm::span<const char> key,
+                      uint32_t                    matchKeySize,
+                      uint32_t                    maxRows,
+                      eosio::vm::span<char>       dest);
       uint32_t kvLessThan(uint32_t handle, eosio::vm::span<const char> key, uint32_t matchKeySize);
       uint32_t kvMax(uint32_t handle, eosio::vm::span<const char> key);
       uint32_t kvGetTransactionUsage();
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <psibase/db.hpp>
+#include <vector>
+
+namespace psibase
+{
+   struct SharedState;
+   struct SystemContext;
+
+   // Passes a message that was received on a host socket to the proxy's recv export
+   void callRecv(SystemContext&           systemContext,
+                 WriterPtr                writer,
+                 std::int32_t             socket,
+                 const std::vector<char>& data);
+
+   // Runs recv for incoming socket messages on a pool of threads, so that
+   // they don't hold up the thread that received them. Each thread has its
+   // own SystemContext. Messages with the same origin are handled in the
+   // order that they were pushed. When maxQueued messages are waiting, new
+   // messages are dropped.
+   class RecvThreadPool
+   {
+     public:
+      static constexpr std::size_t maxQueued = 4096;
+
+      RecvThreadPool(std::shared_ptr<SharedState> sharedState, std::size_t numThreads);
+      ~RecvThreadPool();
+      // origin identifies the sender of the message, e.g. the peer that it
+      // arrived from. All messages may be delivered to the same socket.
+      void push(std::int32_t socket, std::int64_t origin, std::vector<char> data);
+      // Messages that are still queued when the number of threads
+      // is reduced to 0 will be handled if threads are started again.
+      void setNumThreads(std::size_t numThreads);
+
+     private:
+      struct Impl;
+      std::unique_ptr<Impl> impl;
+   };
+}  // namespace psibase
@@ -8,6 +8,7 @@ namespace psibase
    struct WatchdogManager;
    struct Sockets;
    struct Mount;
+   struct BlockContext;
 
    struct SystemContext
    {
@@ -18,6 +19,12 @@ namespace psibase
       std::shared_ptr<Sockets>         sockets;
       std::shared_ptr<Mount>           mountpoints;
 
+      // A started block that queries run in. It is reused by later
+      // queries until the head changes. See getQueryContext. While the
+      // context is pooled, SharedState releases it once the head moves.
+      std::shared_ptr<BlockContext> queryContext;
+      ConstRevisionPtr              queryRevision;
+
       void setNumMemories(size_t n)
       {
          if (n < executionMemories.size())
@@ -47,5 +54,10 @@ namespace psibase
 
       std::unique_ptr<SystemContext> getSystemContext();
       void                           addSystemContext(std::unique_ptr<SystemContext> context);
+
+      // Releases the query contexts of the pooled system contexts that were
+      // started at a revision other than head. They hold their revision and
+      // writer, which keeps the database from freeing the replaced nodes.
+      void releaseQueryContexts(const ConstRevisionPtr& head);
    };
 }  // namespace psibase
@@ -40,6 +40,10 @@ namespace psibase
       // sockets that will be closed when the transaction context finishes
       SocketAutoCloseSet ownedSockets;
 
+      // Local service code that was written in a subjective checkout. It
+      // is compiled once the checkout is committed.
+      std::set<CodeByHashKeyType> subjectiveCode;
+
       TransactionContext(BlockContext&            blockContext,
                          const SignedTransaction& signedTransaction,
                          TransactionTrace&        transactionTrace,
@@ -54,11 +58,13 @@ namespace psibase
       void execTransaction();
 
       void execNonTrxAction(uint64_t callerFlags, const Action& act, ActionTrace& atrace);
-      void execCalledAction(uint64_t callerFlags, const Action& act, ActionTrace& atrace);
-      void execCalledAction(uint64_t      callerFlags,
-                            const Action& act,
-                            ActionTrace&  atrace,
-                            CallFlags     flags);
+      // act is moved into atrace.action, which is also the action
+      // seen by the callee.
+      void execCalledAction(uint64_t callerFlags, Action&& act, ActionTrace& atrace);
+      void execCalledAction(uint64_t     callerFlags,
+                            Action&&     act,
+                            ActionTrace& atrace,
+                            CallFlags    flags);
       void execServe(const Action& act, ActionTrace& atrace);
       void execExport(std::string_view fn, const Action& action, ActionTrace& atrace);
 
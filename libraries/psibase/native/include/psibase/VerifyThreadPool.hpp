@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace psibase
+{
+   struct SystemContext;
+   struct SharedState;
+
+   // A fixed set of threads that verify transaction proofs. Each thread
+   // takes a SystemContext from the SharedState when it runs its first task
+   // and keeps it until the pool is destroyed, so that the verify services
+   // stay instantiated between blocks. Tasks run in the order that they
+   // were posted and must not throw.
+   class VerifyThreadPool
+   {
+     public:
+      using Task = std::function<void(SystemContext&)>;
+
+      VerifyThreadPool(std::shared_ptr<SharedState> sharedState, std::size_t numThreads);
+      ~VerifyThreadPool();
+      std::size_t size() const;
+      void        post(Task task);
+
+     private:
+      struct Impl;
+      std::unique_ptr<Impl> impl;
+   };
+}  // namespace psibase
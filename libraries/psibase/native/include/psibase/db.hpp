@@ -10,6 +10,7 @@
 
 #include <array>
 #include <filesystem>
+#include <span>
 
 namespace triedent
 {
@@ -135,6 +136,35 @@ namespace psibase
       ConstRevisionPtr getRevision(Writer& writer, const Checksum256& blockId);
       void             removeRevisions(Writer& writer, const Checksum256& irreversible);
 
+      // Returns true if the keys in [lower, upper) of a chain database are
+      // the same in both revisions. This may return false even if the range
+      // is logically unchanged, but it never returns true for a changed range.
+      bool isUnchanged(Writer&                 writer,
+                       const ConstRevisionPtr& r1,
+                       const ConstRevisionPtr& r2,
+                       DbId                    db,
+                       std::span<const char>   lower,
+                       std::span<const char>   upper);
+      // The same for a subjective database
+      bool isUnchanged(Writer&                    writer,
+                       const IndependentRevision& r1,
+                       const IndependentRevision& r2,
+                       DbId                       db,
+                       std::span<const char>      lower,
+                       std::span<const char>      upper);
+
+      // Computes the KvMerkle root of a chain database. The keys are split
+      // at the inner nodes near the root of the trie, and the parts are
+      // hashed on up to numThreads threads.
+      //
+      // If the cache is enabled, this instead reuses the nodes of every
+      // subtree that is unchanged since the last call, on one thread.
+      Checksum256 kvMerkleRoot(const ConstRevisionPtr& revision, DbId db, std::size_t numThreads);
+      // Keeps the KvMerkle node of each subtree of the last revision passed
+      // to kvMerkleRoot. This holds that revision and uses memory in
+      // proportion to the number of nodes in the database.
+      void enableKvMerkleCache();
+
       void kvPutSubjective(Writer&               writer,
                            DbId                  db,
                            std::span<const char> key,
@@ -152,6 +182,10 @@ namespace psibase
                                            SocketChangeSet&&      socketChanges,
                                            Sockets&               sockets,
                                            SocketAutoCloseSet&    closing);
+      // Makes the next count calls to commitSubjective that have changes fail
+      // as if another writer had modified the data that they read. Conflicts
+      // only happen under concurrency, so this lets tests exercise retries.
+      void failSubjectiveCommits(std::uint32_t count);
 
       bool                               isSlow() const;
       std::vector<std::span<const char>> span() const;
@@ -247,6 +281,8 @@ namespace psibase
       std::int32_t socketEnableP2P(std::int32_t        socket,
                                    Sockets&            sockets,
                                    SocketAutoCloseSet& closing);
+      // Returns the number of nested checkouts
+      std::size_t subjectiveDepth() const;
       // Used to ensure that checkout and commit are run in the same action
       std::size_t saveSubjective();
       void        restoreSubjective(std::size_t depth);
@@ -258,13 +294,55 @@ namespace psibase
 
       void kvPutRaw(DbId db, psio::input_stream key, psio::input_stream value);
       void kvRemoveRaw(DbId db, psio::input_stream key);
+      // Replaces all rows in [low, high) with rows, which must be sorted by
+      // key and must be inside the range. If high is empty, the range has
+      // no upper bound. This is much faster than kvPutRaw for large numbers
+      // of rows. The subjective databases are not supported.
+      void kvReplaceRangeRaw(DbId                      db,
+                             psio::input_stream        low,
+                             psio::input_stream        high,
+                             std::span<const KVResult> rows);
       std::optional<psio::input_stream> kvGetRaw(DbId db, psio::input_stream key);
-      std::optional<KVResult>           kvGreaterEqualRaw(DbId               db,
-                                                          psio::input_stream key,
-                                                          size_t             matchKeySize);
+      // Like kvGetRaw, but does not copy the value
+      bool kvExistsRaw(DbId db, psio::input_stream key);
+      // Copies the value directly into dest if it fits and otherwise
+      // into overflow. Returns the size of the value.
+      std::optional<std::uint32_t> kvGetInto(DbId               db,
+                                             psio::input_stream key,
+                                             std::span<char>    dest,
+                                             std::vector<char>& overflow);
+      std::optional<KVResult> kvGreaterEqualRaw(DbId               db,
+                                                psio::input_stream key,
+                                                size_t             matchKeySize);
       std::optional<KVResult> kvLessThanRaw(DbId db, psio::input_stream key, size_t matchKeySize);
       std::optional<KVResult> kvMaxRaw(DbId db, psio::input_stream key);
 
+      // Iterates over the rows of a database in key order. Each step
+      // continues from the current row instead of searching from the root,
+      // so a scan is linear in the number of rows. The iterator sees the
+      // database as it was when the iterator was created. It must be used
+      // on the same thread as the Database. On a subjective database, each
+      // step is recorded in the change set like kvGreaterEqualRaw or
+      // kvLessThanRaw, so the iterator must not be used after the checkout
+      // that it was created in ends.
+      struct KVIterator
+      {
+         struct Impl;
+         std::unique_ptr<Impl> impl;
+
+         explicit KVIterator(std::unique_ptr<Impl> impl);
+         KVIterator(KVIterator&&);
+         ~KVIterator();
+
+         // Moves to the first row whose key is >= key. Rows whose keys don't
+         // begin with the first matchKeySize bytes of key are treated as
+         // missing by this and by subsequent calls to next and prev.
+         std::optional<KVResult> seek(psio::input_stream key, size_t matchKeySize);
+         std::optional<KVResult> next();
+         std::optional<KVResult> prev();
+      };
+      KVIterator kvIterator(DbId db);
+
       template <typename K, typename V>
       auto kvPut(DbId db, const K& key, const V& value)
           -> std::enable_if_t<!psio::is_std_optional<V>(), void>
@@ -287,6 +365,12 @@ namespace psibase
          return psio::from_frac<V>(psio::prevalidated{s->pos, s->end});
       }
 
+      template <typename K>
+      bool kvExists(DbId db, const K& key)
+      {
+         return kvExistsRaw(db, psio::convert_to_key(key));
+      }
+
       template <typename V, typename K>
       V kvGetOrDefault(DbId db, const K& key)
       {
@@ -279,19 +279,62 @@ namespace psibase
       return result;
    }
 
-   std::optional<SignedTransaction> BlockContext::callNextTransaction()
+   ConfigRow BlockContext::getConfig()
+   {
+      if (config)
+         return *config;
+      auto result = db.kvGetOrDefault<ConfigRow>(ConfigRow::db, ConfigRow::key());
+      if (!configModified)
+         config = result;
+      return result;
+   }
+
+   WasmConfigRow BlockContext::getWasmConfig(NativeTableNum table)
+   {
+      auto& cached = table == proofWasmConfigTable ? proofWasmConfig : transactionWasmConfig;
+      if (cached)
+         return *cached;
+      auto result = db.kvGetOrDefault<WasmConfigRow>(WasmConfigRow::db, WasmConfigRow::key(table));
+      if (!configModified)
+         cached = result;
+      return result;
+   }
+
+   void BlockContext::onConfigWrite()
+   {
+      configModified = true;
+      config.reset();
+      transactionWasmConfig.reset();
+      proofWasmConfig.reset();
+   }
+
+   namespace
+   {
+      bool hasTransactions(const std::optional<SignedTransaction>& result)
+      {
+         return result.has_value();
+      }
+      bool hasTransactions(const std::vector<SignedTransaction>& result)
+      {
+         return !result.empty();
+      }
+   }  // namespace
+
+   template <typename R>
+   R BlockContext::callNextTransactionImpl(NotifyType notifyType, std::vector<char> args)
    {
-      auto notifyType = NotifyType::nextTransaction;
+      auto name       = notifyType == NotifyType::nextTransactions ? "nextTransactions"
+                                                                   : "nextTransaction";
       auto notifyData = systemContext.sharedDatabase.kvGetSubjective(
           *writer, DbId::nativeSubjective, psio::convert_to_key(notifyKey(notifyType)));
       if (!notifyData)
       {
-         PSIBASE_LOG(trxLogger, debug) << "nextTransaction not set";
+         PSIBASE_LOG(trxLogger, debug) << name << " not set";
          return {};
       }
       if (!psio::fracpack_validate<NotifyRow>(*notifyData))
       {
-         PSIBASE_LOG(trxLogger, warning) << "invalid nextTransaction row";
+         PSIBASE_LOG(trxLogger, warning) << "invalid " << name << " row";
          return {};
       }
 
@@ -301,18 +344,18 @@ namespace psibase
       auto restore        = psio::finally{[&] { isProducing = oldIsProducing; }};
       isProducing         = true;
 
-      Action action{.sender = AccountNumber{}, .rawData = psio::to_frac(std::tuple())};
+      Action action{.sender = AccountNumber{}, .rawData = std::move(args)};
 
       for (auto a : actions)
       {
          if (a.sender() != AccountNumber{})
          {
-            PSIBASE_LOG(trxLogger, warning) << "Invalid nextTransaction callback" << std::endl;
+            PSIBASE_LOG(trxLogger, warning) << "Invalid " << name << " callback" << std::endl;
             continue;
          }
          if (!a.rawData().empty())
          {
-            PSIBASE_LOG(trxLogger, warning) << "Invalid nextTransaction callback" << std::endl;
+            PSIBASE_LOG(trxLogger, warning) << "Invalid " << name << " callback" << std::endl;
             continue;
          }
          action.service = a.service();
@@ -328,7 +371,7 @@ namespace psibase
             tc.execNonTrxAction(0, action, atrace);
             session.commit();
 
-            std::optional<SignedTransaction> result;
+            R result;
             if (!psio::from_frac(result, atrace.rawRetval))
             {
                BOOST_LOG_SCOPED_LOGGER_TAG(trxLogger, "Trace", std::move(trace));
@@ -339,8 +382,8 @@ namespace psibase
             else
             {
                BOOST_LOG_SCOPED_LOGGER_TAG(trxLogger, "Trace", std::move(trace));
-               PSIBASE_LOG(trxLogger, debug) << "nextTransaction succeeded";
-               if (result)
+               PSIBASE_LOG(trxLogger, debug) << name << " succeeded";
+               if (hasTransactions(result))
                   return result;
             }
          }
@@ -348,12 +391,36 @@ namespace psibase
          {
             trace.error = e.what();
             BOOST_LOG_SCOPED_LOGGER_TAG(trxLogger, "Trace", trace);
-            PSIBASE_LOG(trxLogger, warning) << "nextTransaction failed: " << e.what();
+            PSIBASE_LOG(trxLogger, warning) << name << " failed: " << e.what();
          }
       }
       return {};
    }
 
+   std::optional<SignedTransaction> BlockContext::callNextTransaction()
+   {
+      return callNextTransactionImpl<std::optional<SignedTransaction>>(
+          NotifyType::nextTransaction, psio::to_frac(std::tuple()));
+   }
+
+   std::vector<SignedTransaction> BlockContext::callNextTransactions(std::uint32_t maxCount)
+   {
+      if (systemContext.sharedDatabase.kvGetSubjective(
+              *writer, DbId::nativeSubjective,
+              psio::convert_to_key(notifyKey(NotifyType::nextTransactions))))
+      {
+         // An empty batch means that there is nothing to apply. Asking
+         // nextTransaction as well would run a second callback for nothing.
+         return callNextTransactionImpl<std::vector<SignedTransaction>>(
+             NotifyType::nextTransactions, psio::to_frac(std::tuple(maxCount)));
+      }
+      // Services that only provide a single transaction at a time
+      std::vector<SignedTransaction> result;
+      if (auto trx = callNextTransaction())
+         result.push_back(std::move(*trx));
+      return result;
+   }
+
    std::vector<Checksum256> BlockContext::callPreverify(const SignedTransaction& trx)
    {
       std::vector<Checksum256> tokens(trx.proofs.size());
@@ -763,7 +830,19 @@ namespace psibase
 
       callOnBlock();
 
-      return {session.writeRevision(status->head->blockId), status->head->blockId};
+      // Code from failed transactions is not in the database
+      std::vector<CodeByHashRow> newCode;
+      for (const auto& key : writtenCode)
+      {
+         if (auto row = db.kvGet<CodeByHashRow>(CodeByHashRow::db, key))
+            newCode.push_back(std::move(*row));
+      }
+      auto vmOptions = getWasmConfig(transactionWasmConfigTable).vmOptions;
+
+      auto revision = session.writeRevision(status->head->blockId);
+      for (auto& code : newCode)
+         systemContext.wasmCache.prepare(code.codeHash, vmOptions, std::move(code.code));
+      return {std::move(revision), status->head->blockId};
    }
 
    void BlockContext::verifyProof(const SignedTransaction&                 trx,
@@ -940,4 +1019,20 @@ namespace psibase
       }
    }
 
+   BlockContext& getQueryContext(SystemContext& systemContext, const ConstRevisionPtr& head)
+   {
+      auto& bc = systemContext.queryContext;
+      if (!bc || !bc->active || systemContext.queryRevision != head)
+      {
+         // Release the old block first, so it doesn't keep its revision alive
+         bc.reset();
+         systemContext.queryRevision.reset();
+         bc = std::make_shared<BlockContext>(systemContext, head,
+                                             systemContext.sharedDatabase.createWriter(), true);
+         bc->start();
+         systemContext.queryRevision = head;
+      }
+      return *bc;
+   }
+
 }  // namespace psibase
@@ -1,17 +1,25 @@
 #include <psibase/NativeFunctions.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <boost/multi_index/key.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index_container.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <debug_eos_vm/debug_eos_vm.hpp>
+#include <deque>
 #include <eosio/vm/backend.hpp>
+#include <fstream>
 #include <mutex>
 #include <psibase/ActionContext.hpp>
 #include <psibase/db.hpp>
+#include <psibase/log.hpp>
 #include <psio/finally.hpp>
 #include <psio/from_bin.hpp>
+#include <set>
+#include <thread>
 
 namespace bmi = boost::multi_index;
 
@@ -81,10 +89,39 @@ namespace psibase
 #ifdef __x86_64__
       std::shared_ptr<dwarf::debugger_registration> debug;
 #endif
+      // Compiled in the background and not used since
+      bool          prefetched = false;
+      std::uint64_t uses       = 0;
 
       auto byHash() const { return std::tie(hash, vmOptions); }
    };
 
+   BackendEntry compileBackend(const Checksum256&         hash,
+                               const VMOptions&           vmOptions,
+                               std::vector<std::uint8_t>& code)
+   {
+      BackendEntry       result{hash, vmOptions};
+      psio::input_stream s{reinterpret_cast<const char*>(code.data()), code.size()};
+#ifdef __x86_64__
+      if (dwarf::has_debug_info(s))
+      {
+         debug_eos_vm::debug_instr_map debug;
+         result.backend = std::make_unique<backend_t>(code, nullptr, vmOptions, debug);
+         auto info      = dwarf::get_info_from_wasm(s);
+         result.debug =
+             dwarf::register_with_debugger(info, debug.locs, result.backend->get_module(), s);
+      }
+      else
+      {
+         result.backend = std::make_unique<backend_t>(code, nullptr, vmOptions);
+         result.debug   = dwarf::register_with_debugger(result.backend->get_module());
+      }
+#else
+      result.backend = std::make_unique<backend_t>(code, nullptr, vmOptions);
+#endif
+      return result;
+   }
+
    struct ByAge;
    struct ByHash;
 
@@ -93,23 +130,133 @@ namespace psibase
        bmi::indexed_by<bmi::sequenced<bmi::tag<ByAge>>,
                        bmi::ordered_non_unique<bmi::tag<ByHash>, bmi::key<&BackendEntry::byHash>>>>;
 
+   // The manifest records which modules were in the cache. It does
+   // not contain compiled code; eos-vm's JIT output is tied to the
+   // process that produced it, so the modules are compiled again
+   // when the manifest is loaded.
+   struct WasmCacheManifestEntry
+   {
+      Checksum256 codeHash;
+      VMOptions   vmOptions;
+      PSIO_REFLECT(WasmCacheManifestEntry, codeHash, vmOptions)
+   };
+
+   struct WasmCacheManifest
+   {
+      // Must be changed if the format or the meaning of VMOptions changes
+      static constexpr std::uint32_t currentVersion = 1;
+
+      std::uint32_t                       version = currentVersion;
+      std::vector<WasmCacheManifestEntry> modules;
+      PSIO_REFLECT(WasmCacheManifest, version, modules)
+   };
+
+   struct CompileRequest
+   {
+      Checksum256               hash;
+      VMOptions                 vmOptions;
+      std::vector<std::uint8_t> code;
+   };
+
    struct WasmCacheImpl
    {
-      std::mutex       mutex;
-      uint32_t         cacheSize;
-      BackendContainer backends;
+      std::mutex                 mutex;
+      uint32_t                   cacheSize;
+      BackendContainer           backends;
+      std::size_t                numPrefetched = 0;
+      std::filesystem::path      manifestPath;
+      std::deque<CompileRequest> compileQueue;
+      // Modules from the manifest. Their code is read when they are
+      // compiled, after everything in compileQueue.
+      std::deque<WasmCacheManifestEntry> preloadQueue;
+      std::optional<SharedDatabase>      preloadDb;
+      bool                               manifestChanged = false;
+      std::condition_variable            compileCond;
+      std::thread                        compileThread;
+      bool                               stopping = false;
+
+      // The manifest is also saved while running, so that it
+      // survives a crash
+      static constexpr std::chrono::minutes saveInterval{5};
 
       WasmCacheImpl(uint32_t cacheSize) : cacheSize{cacheSize} {}
+      WasmCacheImpl(uint32_t cacheSize, const std::filesystem::path& dir)
+          : cacheSize{cacheSize}, manifestPath{dir / "wasm-cache"}
+      {
+      }
+
+      ~WasmCacheImpl()
+      {
+         if (compileThread.joinable())
+         {
+            {
+               std::lock_guard<std::mutex> lock{mutex};
+               stopping = true;
+            }
+            compileCond.notify_one();
+            compileThread.join();
+         }
+         if (!manifestPath.empty())
+            trySave();
+      }
+
+      // Must be called with the mutex held
+      void startCompileThread()
+      {
+         if (!compileThread.joinable())
+            compileThread = std::thread{[this] { compileLoop(); }};
+      }
 
+      // Only modules that have been used count against cacheSize
       void add(BackendEntry&& entry)
       {
          std::lock_guard<std::mutex> lock{mutex};
          auto&                       ind = backends.get<ByAge>();
+         manifestChanged                 = true;
          ind.push_back(std::move(entry));
-         while (ind.size() > cacheSize)
-            ind.pop_front();
+         for (auto it = ind.begin(); ind.size() - numPrefetched > cacheSize;)
+         {
+            if (it->prefetched)
+               ++it;
+            else
+               it = ind.erase(it);
+         }
+      }
+
+      // Modules compiled in the background have their own budget
+      static constexpr std::size_t maxPrefetched = 16;
+
+      // A module compiled in the background uses free space if there is
+      // any. Otherwise it is kept in the background budget, where it can
+      // only replace another background module, so that a burst of
+      // deployments can't push the modules that are running out of the
+      // cache.
+      void addPrefetched(BackendEntry&& entry)
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         auto&                       ind = backends.get<ByAge>();
+         manifestChanged                 = true;
+         if (ind.size() - numPrefetched < cacheSize)
+         {
+            ind.push_back(std::move(entry));
+            return;
+         }
+         if (numPrefetched == maxPrefetched)
+         {
+            ind.erase(std::find_if(ind.begin(), ind.end(), [](auto& x) { return x.prefetched; }));
+            --numPrefetched;
+         }
+         entry.prefetched = true;
+         ind.push_back(std::move(entry));
+         ++numPrefetched;
       }
 
+      // A backend is removed from the cache while a context uses it, so a
+      // thread that needs a module that is in use elsewhere compiles its own
+      // copy. The backends can't be shared: an eos-vm backend owns its
+      // execution context, and asyncTimeout stops a context by revoking
+      // execute permission on the module's code, which would stop every
+      // thread running that module.
       BackendEntry get(const Checksum256& hash, const VMOptions& vmOptions)
       {
          BackendEntry                result{hash, vmOptions};
@@ -120,19 +267,272 @@ namespace psibase
             return result;
          ind.modify(it, [&](auto& x) { result = std::move(x); });
          ind.erase(it);
+         if (result.prefetched)
+         {
+            result.prefetched = false;
+            --numPrefetched;
+         }
+         ++result.uses;
          result.backend->get_module().allocator.enable_code(impl_t::is_jit);
          return result;
       }
+
+      // Queued requests hold their code in memory until they are compiled
+      static constexpr std::size_t maxCompileQueue = 16;
+
+      void enqueue(CompileRequest&& request)
+      {
+         {
+            std::lock_guard<std::mutex> lock{mutex};
+            auto                        key = std::tie(request.hash, request.vmOptions);
+            if (backends.get<ByHash>().count(key))
+               return;
+            for (const auto& queued : compileQueue)
+               if (std::tie(queued.hash, queued.vmOptions) == key)
+                  return;
+            if (compileQueue.size() < maxCompileQueue)
+            {
+               compileQueue.push_back(std::move(request));
+               startCompileThread();
+               compileCond.notify_one();
+               return;
+            }
+         }
+         // The module will be compiled on first use instead
+         PSIBASE_LOG(loggers::generic::get(), info)
+             << "Compile queue is full. Skipped " << loggers::to_string(request.hash);
+      }
+
+      void compileLoop()
+      {
+         std::unique_lock<std::mutex> lock{mutex};
+         auto                         nextSave = std::chrono::steady_clock::now() + saveInterval;
+         while (true)
+         {
+            compileCond.wait_until(
+                lock, nextSave,
+                [&] { return stopping || !compileQueue.empty() || !preloadQueue.empty(); });
+            if (stopping)
+               return;
+            if (std::chrono::steady_clock::now() >= nextSave)
+            {
+               nextSave = std::chrono::steady_clock::now() + saveInterval;
+               if (manifestChanged && !manifestPath.empty())
+               {
+                  manifestChanged = false;
+                  lock.unlock();
+                  trySave();
+                  lock.lock();
+                  continue;
+               }
+            }
+            if (!compileQueue.empty())
+            {
+               auto request = std::move(compileQueue.front());
+               compileQueue.pop_front();
+               if (backends.get<ByHash>().count(std::tie(request.hash, request.vmOptions)))
+                  continue;
+               lock.unlock();
+               compile(request.hash, request.vmOptions, request.code);
+               lock.lock();
+            }
+            else if (!preloadQueue.empty())
+            {
+               auto [hash, vmOptions] = preloadQueue.front();
+               preloadQueue.pop_front();
+               if (backends.get<ByHash>().count(std::tie(hash, vmOptions)))
+                  continue;
+               auto db = *preloadDb;
+               if (preloadQueue.empty())
+                  preloadDb.reset();
+               lock.unlock();
+               if (auto code = readCode(db, hash))
+                  compile(hash, vmOptions, *code);
+               lock.lock();
+            }
+         }
+      }
+
+      void compile(const Checksum256&         hash,
+                   const VMOptions&           vmOptions,
+                   std::vector<std::uint8_t>& code)
+      {
+         try
+         {
+            rethrowVMExcept([&] { addPrefetched(compileBackend(hash, vmOptions, code)); });
+         }
+         catch (std::exception& e)
+         {
+            PSIBASE_LOG(loggers::generic::get(), warning)
+                << "Failed to compile " << loggers::to_string(hash) << ": " << e.what();
+         }
+      }
+
+      // Reads code from the head block, or from the local services
+      static std::optional<std::vector<std::uint8_t>> readCode(SharedDatabase&    shared,
+                                                               const Checksum256& codeHash)
+      {
+         try
+         {
+            Database db{shared, shared.getHead()};
+            auto     session = db.startRead();
+            db.checkoutSubjective();
+            psio::finally _{[&] { db.abortSubjective(); }};
+            auto          key  = codeByHashKey(codeHash, 0, 0);
+            auto          code = db.kvGet<CodeByHashRow>(DbId::native, key);
+            if (!code)
+               code = db.kvGet<CodeByHashRow>(DbId::nativeSubjective, key);
+            if (!code)
+               return std::nullopt;
+            return std::move(code->code);
+         }
+         catch (std::exception& e)
+         {
+            PSIBASE_LOG(loggers::generic::get(), warning)
+                << "Failed to read code " << loggers::to_string(codeHash) << ": " << e.what();
+            return std::nullopt;
+         }
+      }
+
+      void trySave()
+      {
+         try
+         {
+            save();
+         }
+         catch (std::exception& e)
+         {
+            PSIBASE_LOG(loggers::generic::get(), warning)
+                << "Failed to save " << manifestPath.native() << ": " << e.what();
+         }
+      }
+
+      // Least used first, without duplicates. Modules with the same
+      // number of uses are ordered oldest first.
+      void save()
+      {
+         WasmCacheManifest manifest;
+         {
+            std::lock_guard<std::mutex>                                   lock{mutex};
+            std::set<std::tuple<Checksum256, VMOptions>>                  seen;
+            std::vector<std::pair<std::uint64_t, WasmCacheManifestEntry>> modules;
+
+            auto& ind = backends.get<ByAge>();
+            for (auto it = ind.rbegin(); it != ind.rend(); ++it)
+            {
+               if (seen.insert(it->byHash()).second)
+                  modules.push_back({it->uses, {it->hash, it->vmOptions}});
+            }
+            std::ranges::reverse(modules);
+            std::ranges::stable_sort(modules, {}, [](const auto& m) { return m.first; });
+            for (auto& [uses, entry] : modules)
+               manifest.modules.push_back(entry);
+         }
+
+         auto data    = psio::convert_to_frac(manifest);
+         auto tmpPath = manifestPath;
+         tmpPath += ".tmp";
+         {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            out.write(data.data(), data.size());
+            if (!out)
+               throw std::runtime_error("write failed");
+         }
+         std::filesystem::rename(tmpPath, manifestPath);
+      }
+
+      std::vector<WasmCacheManifestEntry> load()
+      {
+         if (manifestPath.empty())
+            return {};
+         std::ifstream in(manifestPath, std::ios::binary);
+         if (!in)
+            return {};
+         std::vector<char> data{std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>()};
+         if (!psio::fracpack_validate<WasmCacheManifest>(data))
+            return {};
+         auto manifest = psio::from_frac<WasmCacheManifest>(psio::prevalidated{data});
+         if (manifest.version != WasmCacheManifest::currentVersion)
+            return {};
+         return std::move(manifest.modules);
+      }
    };
 
    WasmCache::WasmCache(uint32_t cacheSize) : impl{std::make_shared<WasmCacheImpl>(cacheSize)} {}
 
+   WasmCache::WasmCache(uint32_t cacheSize, const std::filesystem::path& dir)
+       : impl{std::make_shared<WasmCacheImpl>(cacheSize, dir)}
+   {
+   }
+
    WasmCache::WasmCache(const WasmCache& src) : impl{src.impl} {}
 
    WasmCache::WasmCache(WasmCache&& src) : impl{std::move(src.impl)} {}
 
    WasmCache::~WasmCache() {}
 
+   void WasmCache::preload(const SharedDatabase& sharedDb)
+   {
+      if (impl->manifestPath.empty())
+         return;
+      auto modules = impl->load();
+      {
+         std::lock_guard<std::mutex> lock{impl->mutex};
+         // The most used modules are at the end of the manifest
+         impl->preloadQueue.insert(impl->preloadQueue.end(), modules.rbegin(), modules.rend());
+         if (!impl->preloadQueue.empty())
+            impl->preloadDb.emplace(sharedDb);
+         // Also saves the manifest periodically
+         impl->startCompileThread();
+      }
+      impl->compileCond.notify_one();
+      PSIBASE_LOG(loggers::generic::get(), info)
+          << "Queued " << modules.size() << " cached modules for compilation";
+   }
+
+   void WasmCache::prepare(const Checksum256&        codeHash,
+                           const VMOptions&          vmOptions,
+                           std::vector<std::uint8_t> code)
+   {
+      impl->enqueue({codeHash, vmOptions, std::move(code)});
+   }
+
+   void WasmCache::prepareServices(const SharedDatabase&          sharedDb,
+                                   std::span<const AccountNumber> services)
+   {
+      SharedDatabase shared{sharedDb};
+      Database       db{shared, shared.getHead()};
+      auto           session = db.startRead();
+      db.checkoutSubjective();
+      psio::finally _{[&] { db.abortSubjective(); }};
+
+      auto transactionConfig = db.kvGetOrDefault<WasmConfigRow>(
+          WasmConfigRow::db, WasmConfigRow::key(transactionWasmConfigTable));
+      auto proofConfig = db.kvGetOrDefault<WasmConfigRow>(WasmConfigRow::db,
+                                                          WasmConfigRow::key(proofWasmConfigTable));
+
+      for (auto service : services)
+      {
+         // Local services replace chain services
+         auto codeDb = DbId::nativeSubjective;
+         auto code   = db.kvGet<CodeRow>(codeDb, codeKey(service));
+         if (!code || code->codeHash == Checksum256{})
+         {
+            codeDb = DbId::native;
+            code   = db.kvGet<CodeRow>(codeDb, codeKey(service));
+         }
+         check(code && code->codeHash != Checksum256{},
+               "service account has no code: " + service.str());
+         auto c = db.kvGet<CodeByHashRow>(
+             codeDb, codeByHashKey(code->codeHash, code->vmType, code->vmVersion));
+         check(c.has_value(), "service code record is missing: " + service.str());
+         if (code->flags & CodeRow::isVerify)
+            prepare(c->codeHash, proofConfig.vmOptions, c->code);
+         prepare(c->codeHash, transactionConfig.vmOptions, std::move(c->code));
+      }
+   }
+
    std::vector<std::span<const char>> WasmCache::span() const
    {
       std::vector<std::span<const char>> result;
@@ -193,12 +593,9 @@ namespace psibase
          psio::finally _{[&] { database.abortSubjective(); }};
          auto [ca, db] = getCode(service);
 
-         code   = std::move(ca);
-         auto c = database.kvGet<CodeByHashRow>(
-             db, codeByHashKey(code.codeHash, code.vmType, code.vmVersion));
-         check(c.has_value(), "service code record is missing");
-         check(c->vmType == 0, "vmType is not 0");
-         check(c->vmVersion == 0, "vmVersion is not 0");
+         code = std::move(ca);
+         check(code.vmType == 0, "vmType is not 0");
+         check(code.vmVersion == 0, "vmVersion is not 0");
          if (transactionContext.dbMode.verifyOnly)
          {
             check(code.flags & CodeRow::isVerify,
@@ -206,35 +603,24 @@ namespace psibase
             // Ignore all other flags
             code.flags &= CodeRow::isVerify;
          }
+         auto hashKey = codeByHashKey(code.codeHash, code.vmType, code.vmVersion);
          rethrowVMExcept(
              [&]
              {
                 backend = transactionContext.blockContext.systemContext.wasmCache.impl->get(
                     code.codeHash, vmOptions);
-                if (!backend.backend)
-                {
-                   psio::input_stream s{reinterpret_cast<const char*>(c->code.data()),
-                                        c->code.size()};
-#ifdef __x86_64__
-                   if (dwarf::has_debug_info(s))
-                   {
-                      debug_eos_vm::debug_instr_map debug;
-                      backend.backend =
-                          std::make_unique<backend_t>(c->code, nullptr, vmOptions, debug);
-                      auto info     = dwarf::get_info_from_wasm(s);
-                      backend.debug = dwarf::register_with_debugger(
-                          info, debug.locs, backend.backend->get_module(), s);
-                   }
-                   else
-                   {
-                      backend.backend = std::make_unique<backend_t>(c->code, nullptr, vmOptions);
-                      backend.debug = dwarf::register_with_debugger(backend.backend->get_module());
-                   }
-#else
-                   backend.backend = std::make_unique<backend_t>(c->code, nullptr, vmOptions);
-#endif
-                }
              });
+         if (backend.backend)
+         {
+            // Only the hash is needed to find the compiled module
+            check(database.kvExists(db, hashKey), "service code record is missing");
+         }
+         else
+         {
+            auto c = database.kvGet<CodeByHashRow>(db, hashKey);
+            check(c.has_value(), "service code record is missing");
+            rethrowVMExcept([&] { backend = compileBackend(code.codeHash, vmOptions, c->code); });
+         }
       }
 
       ~ExecutionContextImpl()
@@ -368,7 +754,9 @@ namespace psibase
       rhf_t::add<&ExecutionContextImpl::kvPut>("env", "kvPut");
       rhf_t::add<&ExecutionContextImpl::kvRemove>("env", "kvRemove");
       rhf_t::add<&ExecutionContextImpl::kvGet>("env", "kvGet");
+      rhf_t::add<&ExecutionContextImpl::kvGetInto>("env", "kvGetInto");
       rhf_t::add<&ExecutionContextImpl::kvGreaterEqual>("env", "kvGreaterEqual");
+      rhf_t::add<&ExecutionContextImpl::kvScan>("env", "kvScan");
       rhf_t::add<&ExecutionContextImpl::kvLessThan>("env", "kvLessThan");
       rhf_t::add<&ExecutionContextImpl::kvMax>("env", "kvMax");
       // rhf_t::add<&ExecutionContextImpl::kvGetTransactionUsage>("env", "kvGetTransactionUsage");
@@ -132,7 +132,7 @@ namespace psibase
          //ctx.incCode(code.codeHash(), code.vmType(), code.vmVersion(), -1);
       }
 
-      void verifyCodeByHashRow(psio::input_stream key, psio::input_stream value)
+      CodeByHashKeyType verifyCodeByHashRow(psio::input_stream key, psio::input_stream value)
       {
          check(psio::fracpack_validate_strict<CodeByHashRow>({value.pos, value.end}),
                "CodeByHashRow has invalid format");
@@ -145,6 +145,7 @@ namespace psibase
          check(key.remaining() == expected_key.size() &&
                    !memcmp(key.pos, expected_key.data(), key.remaining()),
                "CodeByHashRow has incorrect key");
+         return code.key();
       }
 
       void verifyRemoveCodeByHashRow(TransactionContext& ctx,
@@ -336,11 +337,17 @@ namespace psibase
          else if (table == codeTable)
             verifyCodeRow(context, key, value, existing);
          else if (table == codeByHashTable)
-            verifyCodeByHashRow(key, value);
+            context.blockContext.writtenCode.insert(verifyCodeByHashRow(key, value));
          else if (table == configTable)
+         {
             verifyConfigRow(key, value);
+            context.blockContext.onConfigWrite();
+         }
          else if (table == transactionWasmConfigTable || table == proofWasmConfigTable)
+         {
             verifyWasmConfigRow(table, key, value);
+            context.blockContext.onConfigWrite();
+         }
          else if (table == notifyTable)
             verifyNotifyTableRow(key, value);
          else if (table == scheduledSnapshotTable)
@@ -349,8 +356,11 @@ namespace psibase
             throw std::runtime_error("Unrecognized key in nativeConstrained");
       }
 
-      void verifyWriteSubjective(Database& db, psio::input_stream key, psio::input_stream value)
+      void verifyWriteSubjective(TransactionContext& context,
+                                 psio::input_stream  key,
+                                 psio::input_stream  value)
       {
+         auto& db = context.blockContext.db;
          NativeTableNum table;
          check(key.remaining() >= sizeof(table), "Unrecognized key in nativeSubjective");
          memcpy(&table, key.pos, sizeof(table));
@@ -360,7 +370,7 @@ namespace psibase
          else if (table == codeTable)
             verifySubjectiveCodeRow(key, value);
          else if (table == codeByHashTable)
-            verifyCodeByHashRow(key, value);
+            context.subjectiveCode.insert(verifyCodeByHashRow(key, value));
          else if (table == runTable)
             verifySubjectiveRunTableRow(db, key, value);
          else
@@ -401,6 +411,9 @@ namespace psibase
             verifyRemoveCodeRow(context, key, value);
          else if (table == codeByHashTable)
             verifyRemoveCodeByHashRow(context, key, value);
+         else if (table == configTable || table == transactionWasmConfigTable ||
+                  table == proofWasmConfigTable)
+            context.blockContext.onConfigWrite();
       }
 
       uint32_t clearResult(NativeFunctions& self)
@@ -479,8 +492,8 @@ namespace psibase
          self.currentActContext->actionTrace.innerTraces.push_back({ActionTrace{}});
          auto& inner_action_trace =
              std::get<ActionTrace>(self.currentActContext->actionTrace.innerTraces.back().inner);
-         self.currentActContext->transactionContext.execCalledAction(callerFlags, act,
-                                                                     inner_action_trace, flags);
+         self.currentActContext->transactionContext.execCalledAction(
+             callerFlags, std::move(act), inner_action_trace, flags);
 
          self.currentActContext->transactionContext.remainingStack = saved;
       }
@@ -603,7 +616,6 @@ namespace psibase
       remainingStack -= VMOptions::stack_usage_for_call;
       currentActContext->transactionContext.remainingStack = remainingStack;
 
-      // TODO: don't unpack rawData
       check(psio::fracpack_validate_strict<Action>(data), "call: invalid data format");
       auto flags = static_cast<CallFlags>(flagsRaw);
       if (flags == CallFlags::runModeRpc || flags == CallFlags::runModeCallback)
@@ -614,9 +626,9 @@ namespace psibase
       {
          abortMessage("Invalid call flags: " + std::to_string(flagsRaw));
       }
-      auto act         = psio::from_frac<Action>(psio::prevalidated{data});
+      auto act         = psio::view<const Action>(psio::prevalidated{data});
       auto callerFlags = code.flags;
-      if (act.sender != code.codeNum)
+      if (act.sender().unpack() != code.codeNum)
       {
          check((code.flags & CodeRow::isPrivileged) != 0,
                "service is not authorized to call as another sender");
@@ -626,9 +638,10 @@ namespace psibase
       currentActContext->actionTrace.innerTraces.push_back({ActionTrace{}});
       auto& inner_action_trace =
           std::get<ActionTrace>(currentActContext->actionTrace.innerTraces.back().inner);
-      // TODO: avoid reserialization
-      currentActContext->transactionContext.execCalledAction(callerFlags, act, inner_action_trace,
-                                                             flags);
+      // The action is unpacked once, directly into the trace, which
+      // the callee's ActionContext shares.
+      currentActContext->transactionContext.execCalledAction(
+          callerFlags, psio::from_frac<Action>(psio::prevalidated{data}), inner_action_trace, flags);
       setResult(*this, inner_action_trace.rawRetval);
 
       currentActContext->transactionContext.remainingStack = saved;
@@ -801,7 +814,7 @@ namespace psibase
              }
              else if (bucketDb == DbId::nativeSubjective)
              {
-                verifyWriteSubjective(database, fullKey, {value.data(), value.size()});
+                verifyWriteSubjective(transactionContext, fullKey, {value.data(), value.size()});
              }
              else if (bucketDb == DbId::nativeSession)
              {
@@ -855,7 +868,36 @@ namespace psibase
              if (!bucket.isRead())
                 abortMessage("Cannot read from this db handle " + bucket.to_string());
              auto fullKey = bucket.key(key);
-             return setResult(*this, database.kvGetRaw(bucket.db, fullKey));
+             // Copy the value straight from the database into the result
+             result_key.clear();
+             result_value.clear();
+             if (auto size = database.kvGetInto(bucket.db, fullKey, {}, result_value))
+                return *size;
+             return clearResult(*this);
+          });
+   }
+
+   uint32_t NativeFunctions::kvGetInto(uint32_t                    handle,
+                                       eosio::vm::span<const char> key,
+                                       eosio::vm::span<char>       dest)
+   {
+      return timeDb(  //
+          *this,
+          [&]
+          {
+             const auto& bucket = buckets[static_cast<KvHandle>(handle)];
+             if (!bucket.isRead())
+                abortMessage("Cannot read from this db handle " + bucket.to_string());
+             auto fullKey = bucket.key(key);
+             result_key.clear();
+             if (auto size = database.kvGetInto(bucket.db, fullKey,
+                                                {dest.data(), dest.size()}, result_value))
+             {
+                if (*size <= dest.size())
+                   result_value.clear();
+                return *size;
+             }
+             return clearResult(*this);
           });
    }
 
@@ -878,6 +920,52 @@ namespace psibase
           });
    }
 
+   uint32_t NativeFunctions::kvScan(uint32_t                    handle,
+                                    eosio::vm::span<const char> key,
+                                    uint32_t                    matchKeySize,
+                                    uint32_t                    maxRows,
+                                    eosio::vm::span<char>       dest)
+   {
+      return timeDb(  //
+          *this,
+          [&]
+          {
+             check(matchKeySize <= key.size(), "matchKeySize is larger than key");
+             const auto& bucket = buckets[static_cast<KvHandle>(handle)];
+             if (!bucket.isRead())
+                abortMessage("Cannot read from this db handle " + bucket.to_string());
+             clearResult(*this);
+             auto          fullKey       = bucket.key(key);
+             auto          fullMatchSize = bucket.prefix.size() + matchKeySize;
+             auto          iter          = database.kvIterator(bucket.db);
+             std::uint64_t used          = 0;
+             std::uint32_t rows          = 0;
+             for (; rows < maxRows; ++rows)
+             {
+                auto found = bucket.trimResult(rows == 0 ? iter.seek(fullKey, fullMatchSize)
+                                                         : iter.next());
+                if (!found)
+                   break;
+                std::uint32_t keySize   = found->key.remaining();
+                std::uint32_t valueSize = found->value.remaining();
+                std::uint64_t rowSize   = 8 + std::uint64_t{keySize} + valueSize;
+                if (used + rowSize > dest.size())
+                {
+                   if (rows == 0)
+                      return static_cast<uint32_t>(rowSize);
+                   break;
+                }
+                auto pos = dest.data() + used;
+                std::memcpy(pos, &keySize, 4);
+                std::memcpy(pos + 4, found->key.pos, keySize);
+                std::memcpy(pos + 4 + keySize, &valueSize, 4);
+                std::memcpy(pos + 8 + keySize, found->value.pos, valueSize);
+                used += rowSize;
+             }
+             return rows == 0 ? static_cast<uint32_t>(-1) : static_cast<uint32_t>(used);
+          });
+   }
+
    uint32_t NativeFunctions::kvLessThan(uint32_t                    handle,
                                         eosio::vm::span<const char> key,
                                         uint32_t                    matchKeySize)
@@ -925,11 +1013,31 @@ namespace psibase
    }
    bool NativeFunctions::commitSubjective()
    {
-      return database.commitSubjective(*transactionContext.blockContext.systemContext.sockets,
-                                       transactionContext.ownedSockets);
+      auto& blockContext = transactionContext.blockContext;
+      auto& pending      = transactionContext.subjectiveCode;
+      // New local service code is compiled once the outermost checkout
+      // commits. It is read first, because the checkout ends with the
+      // commit. Code from a nested checkout that was aborted is gone.
+      std::vector<CodeByHashRow> newCode;
+      if (database.subjectiveDepth() == 1)
+      {
+         for (const auto& key : pending)
+            if (auto code = database.kvGet<CodeByHashRow>(DbId::nativeSubjective, key))
+               newCode.push_back(std::move(*code));
+         pending.clear();
+      }
+      if (!database.commitSubjective(*blockContext.systemContext.sockets,
+                                     transactionContext.ownedSockets))
+         return false;
+      for (auto& code : newCode)
+         blockContext.systemContext.wasmCache.prepare(
+             code.codeHash, transactionContext.getWasmConfig().vmOptions, std::move(code.code));
+      return true;
    }
    void NativeFunctions::abortSubjective()
    {
+      if (database.subjectiveDepth() == 1)
+         transactionContext.subjectiveCode.clear();
       database.abortSubjective();
    }
 
@@ -0,0 +1,176 @@
+#include <psibase/RecvThreadPool.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <psibase/BlockContext.hpp>
+#include <psibase/SystemContext.hpp>
+#include <psibase/log.hpp>
+#include <psibase/serviceEntry.hpp>
+#include <psio/finally.hpp>
+#include <thread>
+
+namespace psibase
+{
+   void callRecv(SystemContext&           systemContext,
+                 WriterPtr                writer,
+                 std::int32_t             socket,
+                 const std::vector<char>& data)
+   {
+      Action action{.service = proxyServiceNum,
+                    .rawData = psio::to_frac(std::tuple(socket, data, std::uint32_t{0}))};
+
+      auto             service  = action.service;
+      auto             revision = systemContext.sharedDatabase.getHead();
+      BlockContext     bc{systemContext, std::move(revision), std::move(writer), true};
+      TransactionTrace trace;
+      try
+      {
+         auto& atrace = bc.execAsyncExport("recv", std::move(action), trace);
+         BOOST_LOG_SCOPED_LOGGER_TAG(bc.trxLogger, "Trace", std::move(trace));
+         PSIBASE_LOG(bc.trxLogger, debug) << service.str() << "::recv succeeded";
+      }
+      catch (std::exception& e)
+      {
+         BOOST_LOG_SCOPED_LOGGER_TAG(bc.trxLogger, "Trace", std::move(trace));
+         PSIBASE_LOG(bc.trxLogger, warning)
+             << service.str() << "::recv failed: " << e.what();
+      }
+   }
+
+   struct RecvThreadPool::Impl
+   {
+      struct Item
+      {
+         std::int32_t      socket;
+         std::int64_t      origin;
+         std::vector<char> data;
+      };
+
+      std::mutex              mutex;
+      std::condition_variable cond;
+      std::deque<Item>        queue;
+      // Messages that were dropped since the queue filled up
+      std::size_t dropped = 0;
+      // Origins that have a message in progress
+      std::vector<std::int64_t>    running;
+      std::vector<std::jthread>    threads;
+      std::size_t                  numThreads;
+      std::shared_ptr<SharedState> sharedState;
+
+      Impl(std::shared_ptr<SharedState> sharedState, std::size_t numThreads)
+          : numThreads(numThreads), sharedState(std::move(sharedState))
+      {
+      }
+
+      ~Impl()
+      {
+         {
+            std::lock_guard l(mutex);
+            numThreads = 0;
+         }
+         adjustThreads();
+      }
+      // Starts or stops threads to match numThreads
+      void adjustThreads()
+      {
+         if (numThreads > threads.size())
+         {
+            // reserve is required, because the jthread destructor will
+            // deadlock if push_back throws.
+            threads.reserve(numThreads);
+            while (threads.size() < numThreads)
+            {
+               auto id = threads.size();
+               threads.push_back(std::jthread([this, id] { run(id); }));
+            }
+         }
+         else if (numThreads < threads.size())
+         {
+            {
+               std::lock_guard l(mutex);
+               cond.notify_all();
+            }
+            threads.resize(numThreads);
+         }
+      }
+      // Returns the oldest message whose origin is not already in progress
+      std::optional<Item> pop(std::size_t threadIndex)
+      {
+         std::unique_lock l{mutex};
+         while (threadIndex < numThreads)
+         {
+            auto pos = std::ranges::find_if(
+                queue, [this](const Item& item)
+                { return std::ranges::find(running, item.origin) == running.end(); });
+            if (pos != queue.end())
+            {
+               Item result = std::move(*pos);
+               queue.erase(pos);
+               running.push_back(result.origin);
+               return result;
+            }
+            cond.wait(l);
+         }
+         return {};
+      }
+      void finish(std::int64_t origin)
+      {
+         std::lock_guard l{mutex};
+         std::erase(running, origin);
+         // Another message from the same origin may be waiting
+         cond.notify_all();
+      }
+      void run(std::size_t threadIndex)
+      {
+         auto systemContext = sharedState->getSystemContext();
+         auto writer        = systemContext->sharedDatabase.createWriter();
+         while (auto item = pop(threadIndex))
+         {
+            psio::finally f{[&] { finish(item->origin); }};
+            callRecv(*systemContext, writer, item->socket, item->data);
+         }
+         sharedState->addSystemContext(std::move(systemContext));
+      }
+   };
+
+   RecvThreadPool::RecvThreadPool(std::shared_ptr<SharedState> sharedState,
+                                  std::size_t                  numThreads)
+       : impl(new Impl{std::move(sharedState), numThreads})
+   {
+      impl->adjustThreads();
+   }
+
+   RecvThreadPool::~RecvThreadPool() = default;
+
+   void RecvThreadPool::push(std::int32_t socket, std::int64_t origin, std::vector<char> data)
+   {
+      std::lock_guard l{impl->mutex};
+      if (impl->queue.size() >= maxQueued)
+      {
+         if (impl->dropped++ == 0)
+            PSIBASE_LOG(loggers::generic::get(), warning)
+                << "Too many socket messages are waiting for recv. Dropping new messages.";
+         return;
+      }
+      if (impl->dropped != 0)
+      {
+         PSIBASE_LOG(loggers::generic::get(), warning)
+             << "Dropped " << impl->dropped << " socket messages";
+         impl->dropped = 0;
+      }
+      impl->queue.push_back({socket, origin, std::move(data)});
+      impl->cond.notify_all();
+   }
+
+   void RecvThreadPool::setNumThreads(std::size_t numThreads)
+   {
+      {
+         std::lock_guard l(impl->mutex);
+         impl->numThreads = numThreads;
+      }
+      impl->adjustThreads();
+   }
+}  // namespace psibase
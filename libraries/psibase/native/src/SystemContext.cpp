@@ -113,7 +113,28 @@ namespace psibase
 
    void SharedState::addSystemContext(std::unique_ptr<SystemContext> context)
    {
+      if (context->queryContext && context->queryRevision != context->sharedDatabase.getHead())
+      {
+         context->queryContext.reset();
+         context->queryRevision.reset();
+      }
       std::lock_guard<std::mutex> lock{impl->mutex};
       impl->systemContextCache.push_back(std::move(context));
    }
+
+   void SharedState::releaseQueryContexts(const ConstRevisionPtr& head)
+   {
+      // Destroyed after the lock is released
+      std::vector<std::shared_ptr<BlockContext>> contexts;
+      std::vector<ConstRevisionPtr>              revisions;
+      std::lock_guard<std::mutex>                lock{impl->mutex};
+      for (auto& context : impl->systemContextCache)
+      {
+         if (context->queryContext && context->queryRevision != head)
+         {
+            contexts.push_back(std::move(context->queryContext));
+            revisions.push_back(std::move(context->queryRevision));
+         }
+      }
+   }
 }  // namespace psibase
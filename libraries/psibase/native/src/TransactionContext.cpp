@@ -75,10 +75,8 @@ namespace psibase
    {
       ScopedAtomic saved{impl->vmTimedOut};
       // Prepare for execution
-      auto& db         = blockContext.db;
-      config           = db.kvGetOrDefault<ConfigRow>(ConfigRow::db, ConfigRow::key());
-      impl->wasmConfig = db.kvGetOrDefault<WasmConfigRow>(
-          WasmConfigRow::db, WasmConfigRow::key(transactionWasmConfigTable));
+      config           = blockContext.getConfig();
+      impl->wasmConfig = blockContext.getWasmConfig(transactionWasmConfigTable);
       blockContext.systemContext.setNumMemories(impl->wasmConfig.numExecutionMemories);
       remainingStack = impl->wasmConfig.vmOptions.max_stack_bytes;
 
@@ -99,8 +97,7 @@ namespace psibase
 
       // If the transaction adjusted numExecutionMemories too big for this node, then attempt
       // to reject the transaction. It is possible for the node to go down in flames instead.
-      impl->wasmConfig = db.kvGetOrDefault<WasmConfigRow>(
-          WasmConfigRow::db, WasmConfigRow::key(transactionWasmConfigTable));
+      impl->wasmConfig = blockContext.getWasmConfig(transactionWasmConfigTable);
       blockContext.systemContext.setNumMemories(impl->wasmConfig.numExecutionMemories);
    }
 
@@ -188,10 +185,8 @@ namespace psibase
                                             std::vector<char>  proof)
    {
       ScopedAtomic saved{impl->vmTimedOut};
-      auto&        db  = blockContext.db;
-      config           = db.kvGetOrDefault<ConfigRow>(ConfigRow::db, ConfigRow::key());
-      impl->wasmConfig = db.kvGetOrDefault<WasmConfigRow>(WasmConfigRow::db,
-                                                          WasmConfigRow::key(proofWasmConfigTable));
+      config           = blockContext.getConfig();
+      impl->wasmConfig = blockContext.getWasmConfig(proofWasmConfigTable);
       blockContext.systemContext.setNumMemories(impl->wasmConfig.numExecutionMemories);
       remainingStack = impl->wasmConfig.vmOptions.max_stack_bytes;
 
@@ -227,11 +222,9 @@ namespace psibase
                                              ActionTrace&  atrace)
    {
       ScopedAtomic saved{impl->vmTimedOut};
-      auto&        db      = blockContext.db;
-      config               = db.kvGetOrDefault<ConfigRow>(ConfigRow::db, ConfigRow::key());
+      config               = blockContext.getConfig();
       auto wasmConfigTable = dbMode.verifyOnly ? proofWasmConfigTable : transactionWasmConfigTable;
-      impl->wasmConfig =
-          db.kvGetOrDefault<WasmConfigRow>(WasmConfigRow::db, WasmConfigRow::key(wasmConfigTable));
+      impl->wasmConfig     = blockContext.getWasmConfig(wasmConfigTable);
       blockContext.systemContext.setNumMemories(impl->wasmConfig.numExecutionMemories);
       remainingStack = impl->wasmConfig.vmOptions.max_stack_bytes;
 
@@ -250,15 +243,15 @@ namespace psibase
       }
    }
 
-   void TransactionContext::execCalledAction(uint64_t      callerFlags,
-                                             const Action& action,
-                                             ActionTrace&  atrace)
+   void TransactionContext::execCalledAction(uint64_t     callerFlags,
+                                             Action&&     action,
+                                             ActionTrace& atrace)
    {
-      atrace.action    = action;
-      ActionContext ac = {*this, action, atrace};
+      atrace.action    = std::move(action);
+      ActionContext ac = {*this, atrace.action, atrace};
       try
       {
-         auto& ec = getExecutionContext(action.service);
+         auto& ec = getExecutionContext(atrace.action.service);
          ec.execCalled(callerFlags, ac);
       }
       catch (std::exception& e)
@@ -268,14 +261,14 @@ namespace psibase
       }
    }
 
-   void TransactionContext::execCalledAction(uint64_t      callerFlags,
-                                             const Action& action,
-                                             ActionTrace&  atrace,
-                                             CallFlags     flags)
+   void TransactionContext::execCalledAction(uint64_t     callerFlags,
+                                             Action&&     action,
+                                             ActionTrace& atrace,
+                                             CallFlags    flags)
    {
       if (flags == CallFlags::none)
       {
-         execCalledAction(callerFlags, action, atrace);
+         execCalledAction(callerFlags, std::move(action), atrace);
       }
       else
       {
@@ -300,7 +293,7 @@ namespace psibase
          if (blockContext.isProducing)
          {
             auto mode = scopedChangeMode();
-            execCalledAction(callerFlags, action, atrace);
+            execCalledAction(callerFlags, std::move(action), atrace);
             subjectiveData.push_back(atrace.rawRetval);
          }
          else
@@ -310,7 +303,7 @@ namespace psibase
                try
                {
                   auto mode = scopedChangeMode();
-                  execCalledAction(callerFlags, action, atrace);
+                  execCalledAction(callerFlags, std::move(action), atrace);
                }
                catch (...)
                {
@@ -331,10 +324,8 @@ namespace psibase
    void TransactionContext::execServe(const Action& action, ActionTrace& atrace)
    {
       ScopedAtomic saved{impl->vmTimedOut};
-      auto&        db  = blockContext.db;
-      config           = db.kvGetOrDefault<ConfigRow>(ConfigRow::db, ConfigRow::key());
-      impl->wasmConfig = db.kvGetOrDefault<WasmConfigRow>(
-          WasmConfigRow::db, WasmConfigRow::key(transactionWasmConfigTable));
+      config           = blockContext.getConfig();
+      impl->wasmConfig = blockContext.getWasmConfig(transactionWasmConfigTable);
       blockContext.systemContext.setNumMemories(impl->wasmConfig.numExecutionMemories);
       remainingStack = impl->wasmConfig.vmOptions.max_stack_bytes;
 
@@ -358,10 +349,8 @@ namespace psibase
                                        ActionTrace&     atrace)
    {
       ScopedAtomic saved{impl->vmTimedOut};
-      auto&        db  = blockContext.db;
-      config           = db.kvGetOrDefault<ConfigRow>(ConfigRow::db, ConfigRow::key());
-      impl->wasmConfig = db.kvGetOrDefault<WasmConfigRow>(
-          WasmConfigRow::db, WasmConfigRow::key(transactionWasmConfigTable));
+      config           = blockContext.getConfig();
+      impl->wasmConfig = blockContext.getWasmConfig(transactionWasmConfigTable);
       blockContext.systemContext.setNumMemories(impl->wasmConfig.numExecutionMemories);
       remainingStack = impl->wasmConfig.vmOptions.max_stack_bytes;
 
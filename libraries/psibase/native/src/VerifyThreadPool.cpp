@@ -0,0 +1,78 @@
+#include <psibase/VerifyThreadPool.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <psibase/SystemContext.hpp>
+#include <thread>
+#include <vector>
+
+namespace psibase
+{
+   struct VerifyThreadPool::Impl
+   {
+      std::shared_ptr<SharedState> sharedState;
+      std::mutex                   mutex;
+      std::condition_variable      cond;
+      std::deque<Task>             queue;
+      bool                         done = false;
+      std::vector<std::jthread>    threads;
+
+      std::optional<Task> pop()
+      {
+         std::unique_lock l{mutex};
+         cond.wait(l, [this] { return done || !queue.empty(); });
+         if (queue.empty())
+            return {};
+         auto result = std::move(queue.front());
+         queue.pop_front();
+         return result;
+      }
+      void run()
+      {
+         std::unique_ptr<SystemContext> context;
+         while (auto task = pop())
+         {
+            if (!context)
+               context = sharedState->getSystemContext();
+            (*task)(*context);
+         }
+         if (context)
+            sharedState->addSystemContext(std::move(context));
+      }
+   };
+
+   VerifyThreadPool::VerifyThreadPool(std::shared_ptr<SharedState> sharedState,
+                                      std::size_t                  numThreads)
+       : impl(new Impl{std::move(sharedState)})
+   {
+      // reserve is required, because the jthread destructor will
+      // deadlock if push_back throws.
+      impl->threads.reserve(numThreads);
+      for (std::size_t i = 0; i < numThreads; ++i)
+         impl->threads.push_back(std::jthread([this] { impl->run(); }));
+   }
+
+   VerifyThreadPool::~VerifyThreadPool()
+   {
+      {
+         std::lock_guard l{impl->mutex};
+         impl->done = true;
+         impl->cond.notify_all();
+      }
+      impl->threads.clear();
+   }
+
+   std::size_t VerifyThreadPool::size() const
+   {
+      return impl->threads.size();
+   }
+
+   void VerifyThreadPool::post(Task task)
+   {
+      std::lock_guard l{impl->mutex};
+      impl->queue.push_back(std::move(task));
+      impl->cond.notify_one();
+   }
+}  // namespace psibase
@@ -1,10 +1,16 @@
 #include <psibase/db.hpp>
 
 #include <boost/filesystem/operations.hpp>
+#include <psibase/KvMerkle.hpp>
 #include <psibase/Socket.hpp>
 #include <psibase/nativeTables.hpp>
 #include <triedent/database.hpp>
 
+#include <atomic>
+#include <bit>
+#include <ranges>
+#include <thread>
+
 namespace psibase
 {
    static constexpr uint8_t revisionHeadPrefix = 0;
@@ -97,6 +103,66 @@ namespace psibase
          return static_cast<std::uint32_t>(db) - static_cast<std::uint32_t>(DbId::beginIndependent);
       }
 
+      // The KvMerkle node for the keys in a subtree that begin with the
+      // key6 of the branch that leads to the subtree, and the leaf for the
+      // key at the top of the subtree if it is too short to begin with it.
+      struct KvMerkleNode
+      {
+         Checksum256 hash;
+         Checksum256 shortLeaf;
+      };
+
+      std::span<const unsigned char> asBytes(std::string_view s)
+      {
+         return {reinterpret_cast<const unsigned char*>(s.data()), s.size()};
+      }
+
+      KvMerkleNode combineKvMerkle(const triedent::subtree_cache<KvMerkleNode>::node_info& node)
+      {
+         KvMerkleNode result = {};
+         KvMerkle     merkle;
+         if (node.value)
+         {
+            auto key  = triedent::from_key6(node.key);
+            auto leaf = KvMerkle::Item{key, *node.value}.get_hash();
+            if (key.size() * 8 < node.prefix_size * 6)
+               result.shortLeaf = leaf;
+            else
+               merkle.push_hash(asBytes(key), leaf);
+         }
+
+         // The prefix of each child in bytes, padded with 0 bits
+         auto                     bits = (node.key.size() + 1) * 6;
+         std::vector<std::string> prefixes;
+         std::string              key6{node.key};
+         for (const auto& child : node.children)
+         {
+            key6.resize(node.key.size());
+            key6.push_back(child.branch);
+            if (bits % 8)
+               key6.push_back(0);
+            prefixes.push_back(triedent::from_key6(key6));
+         }
+
+         // The short leaves of the children have all the whole bytes of a child's
+         // prefix, so they come before every child whose prefix has the same bytes
+         auto wholeBytes = [&](std::size_t i) { return prefixes[i].substr(0, bits / 8); };
+         for (std::size_t i = 0; i < node.children.size();)
+         {
+            auto end = i + 1;
+            while (end < node.children.size() && wholeBytes(end) == wholeBytes(i))
+               ++end;
+            for (auto j = i; j < end; ++j)
+               if (node.children[j].value->shortLeaf != Checksum256{})
+                  merkle.push_hash(asBytes(wholeBytes(j)), node.children[j].value->shortLeaf);
+            for (auto j = i; j < end; ++j)
+               if (node.children[j].value->hash != Checksum256{})
+                  merkle.push_subtree(asBytes(prefixes[j]), bits, node.children[j].value->hash);
+            i = end;
+         }
+         result.hash = std::move(merkle).root();
+         return result;
+      }
    }  // namespace
    void DbChangeSet::onRead(std::span<const char> key)
    {
@@ -182,6 +248,11 @@ namespace psibase
 
       std::mutex          subjectiveMutex;
       IndependentRevision subjective;
+      std::uint32_t       failSubjectiveCommits = 0;
+
+      std::mutex kvMerkleMutex;
+      std::unique_ptr<std::array<triedent::subtree_cache<KvMerkleNode>, numChainDatabases>>
+          kvMerkleCache;
 
       static constexpr auto numPersistentDatabases =
           static_cast<std::uint32_t>(DbId::endPersistent) -
@@ -307,6 +378,156 @@ namespace psibase
       return loadRevision(writer, impl->getTopRoot(), revisionById(blockId), true);
    }
 
+   bool SharedDatabase::isUnchanged(Writer&                 writer,
+                                    const ConstRevisionPtr& r1,
+                                    const ConstRevisionPtr& r2,
+                                    DbId                    db,
+                                    std::span<const char>   lower,
+                                    std::span<const char>   upper)
+   {
+      check(static_cast<std::uint32_t>(db) < numChainDatabases,
+            "isUnchanged only supports chain databases");
+      if (r1 == r2)
+         return true;
+      const auto& root1 = r1->roots[static_cast<std::uint32_t>(db)];
+      const auto& root2 = r2->roots[static_cast<std::uint32_t>(db)];
+      return writer.is_equal_weak(root1, root2, lower, upper);
+   }
+
+   bool SharedDatabase::isUnchanged(Writer&                    writer,
+                                    const IndependentRevision& r1,
+                                    const IndependentRevision& r2,
+                                    DbId                       db,
+                                    std::span<const char>      lower,
+                                    std::span<const char>      upper)
+   {
+      check(isIndependent(db), "isUnchanged requires a subjective database");
+      const auto& root1 = r1[independentIndex(db)];
+      const auto& root2 = r2[independentIndex(db)];
+      if (root1 == root2)
+         return true;
+      return writer.is_equal_weak(root1, root2, lower, upper);
+   }
+
+   namespace
+   {
+      bool startsWith(std::span<const char> key, const triedent::key_prefix& prefix)
+      {
+         auto bytes = prefix.bits / 8;
+         auto extra = prefix.bits % 8;
+         if (key.size() * 8 < prefix.bits ||
+             !std::equal(prefix.prefix.begin(), prefix.prefix.begin() + bytes, key.begin()))
+            return false;
+         return extra == 0 || ((key[bytes] ^ prefix.prefix[bytes]) & (0xff00 >> extra) & 0xff) == 0;
+      }
+
+      std::size_t commonPrefixBits(const triedent::key_prefix& lhs, const triedent::key_prefix& rhs)
+      {
+         auto [l, r]        = std::ranges::mismatch(lhs.prefix, rhs.prefix);
+         std::size_t result = (l - lhs.prefix.begin()) * 8;
+         if (l != lhs.prefix.end() && r != rhs.prefix.end())
+            result += std::countl_zero(static_cast<unsigned char>(*l ^ *r));
+         return std::min({result, lhs.bits, rhs.bits});
+      }
+   }  // namespace
+
+   Checksum256 SharedDatabase::kvMerkleRoot(const ConstRevisionPtr& revision,
+                                            DbId                    db,
+                                            std::size_t             numThreads)
+   {
+      check(static_cast<std::uint32_t>(db) < numChainDatabases,
+            "kvMerkleRoot only supports chain databases");
+      const auto& root    = revision->roots[static_cast<std::uint32_t>(db)];
+      auto        session = impl->trie->start_read_session();
+      {
+         std::lock_guard l{impl->kvMerkleMutex};
+         if (impl->kvMerkleCache)
+         {
+            auto& cache  = (*impl->kvMerkleCache)[static_cast<std::uint32_t>(db)];
+            auto  result = cache.get(*session, root, combineKvMerkle);
+            return result ? result->hash : Checksum256{};
+         }
+      }
+      auto parts = session->split(root, numThreads * 16);
+
+      // The root of a KvMerkle that only contains the keys that
+      // begin with a prefix is the node for that prefix
+      std::vector<Checksum256> hashes(parts.size());
+      std::atomic<std::size_t> nextPart{0};
+      std::mutex               errorMutex;
+      std::exception_ptr       error;
+      auto                     hashParts = [&]
+      {
+         try
+         {
+            auto              threadSession = impl->trie->start_read_session();
+            triedent::cursor  cursor{*threadSession, root};
+            std::vector<char> key;
+            std::vector<char> value;
+            KvMerkle::Item    item;
+            for (std::size_t i; (i = nextPart++) < parts.size();)
+            {
+               KvMerkle merkle;
+               for (cursor.lower_bound(parts[i].prefix); cursor.valid(); cursor.next())
+               {
+                  cursor.key(key);
+                  if (!startsWith(key, parts[i]))
+                     break;
+                  cursor.value(&value, nullptr);
+                  item.from(key, value);
+                  merkle.push(item);
+               }
+               hashes[i] = std::move(merkle).root();
+            }
+         }
+         catch (...)
+         {
+            std::lock_guard l{errorMutex};
+            if (!error)
+               error = std::current_exception();
+            nextPart = parts.size();
+         }
+      };
+      {
+         std::vector<std::jthread> threads;
+         for (std::size_t i = 1; i < std::min(numThreads, parts.size()); ++i)
+            threads.emplace_back(hashParts);
+         hashParts();
+      }
+      if (error)
+         std::rethrow_exception(error);
+
+      // Combine the parts along with the keys that are too short to
+      // be in any part. These keys are prefixes of the parts.
+      KvMerkle          merkle;
+      std::vector<char> value;
+      for (std::size_t i = 0; i < parts.size(); ++i)
+      {
+         const auto& part = parts[i];
+         // Prefixes that are shared with the previous part were already checked
+         std::size_t len = i == 0 ? 0 : commonPrefixBits(parts[i - 1], part) / 8 + 1;
+         for (; len * 8 < part.bits; ++len)
+         {
+            std::span<const char> key{part.prefix.data(), len};
+            if (session->get(root, key, &value, nullptr))
+               merkle.push(KvMerkle::Item{key, value});
+         }
+         if (hashes[i] != Checksum256{})
+            merkle.push_subtree({reinterpret_cast<const unsigned char*>(part.prefix.data()),
+                                 part.prefix.size()},
+                                part.bits, hashes[i]);
+      }
+      return std::move(merkle).root();
+   }  // kvMerkleRoot
+
+   void SharedDatabase::enableKvMerkleCache()
+   {
+      std::lock_guard l{impl->kvMerkleMutex};
+      if (!impl->kvMerkleCache)
+         impl->kvMerkleCache = std::make_unique<
+             std::array<triedent::subtree_cache<KvMerkleNode>, numChainDatabases>>();
+   }
+
    // TODO: move triedent::root destruction to a gc thread
    void SharedDatabase::removeRevisions(Writer& writer, const Checksum256& irreversible)
    {
@@ -317,10 +538,16 @@ namespace psibase
       std::vector<char> tmpKey;
       bool              hasIrreversible = false;
 
+      // The cursor iterates over the revisions as they were before any were
+      // removed, without searching from the root for each one.
+      triedent::cursor cursor{writer, impl->topRoot};
+      cursor.lower_bound(key);
+
       // Remove everything with a blockNum <= irreversible's, except irreversible
       // and saved snapshots.
-      while (writer.get_greater_equal(impl->topRoot, key, &key, nullptr, nullptr))
+      for (; cursor.valid(); cursor.next())
       {
+         cursor.key(key);
          if (key.size() != 1 + irreversible.size() || key[0] != revisionByIdPrefix ||
              memcmp(key.data() + 1, irreversible.data(), sizeof(BlockNum)) > 0)
             break;
@@ -338,7 +565,6 @@ namespace psibase
             if (!writer.get(nativeSubjective, tmpKey))
                writer.remove(impl->topRoot, key);
          }
-         key.push_back(0);
       }
 
       if (hasIrreversible)
@@ -348,10 +574,12 @@ namespace psibase
          std::vector<std::shared_ptr<triedent::root>> roots;
          std::vector<char>                            statusBytes;
          auto                                         sk = psio::convert_to_key(statusKey());
-         while (writer.get_greater_equal(impl->topRoot, key, &key, nullptr, &roots))
+         for (; cursor.valid(); cursor.next())
          {
+            cursor.key(key);
             if (key.size() != 1 + irreversible.size() || key[0] != revisionByIdPrefix)
                break;
+            cursor.value(nullptr, &roots);
             check(roots.size() == numChainDatabases, "wrong number of roots in fork");
             if (!writer.get(roots[(int)StatusRow::db], sk, &statusBytes, nullptr))
                throw std::runtime_error("Status row missing in fork");
@@ -361,7 +589,6 @@ namespace psibase
             if (!writer.get(impl->topRoot, revisionById(status.head->header.previous), nullptr,
                             nullptr))
                writer.remove(impl->topRoot, key);
-            key.push_back(0);
          }
       }
 
@@ -421,6 +648,12 @@ namespace psibase
       if (hasChange)
       {
          std::lock_guard l{impl->subjectiveMutex};
+         if (impl->failSubjectiveCommits)
+         {
+            --impl->failSubjectiveCommits;
+            original = impl->subjective;
+            return false;
+         }
          for (std::size_t i = 0; i < numIndependentDatabases; ++i)
          {
             for (const auto& r : changes[i].ranges)
@@ -453,6 +686,12 @@ namespace psibase
       return true;
    }
 
+   void SharedDatabase::failSubjectiveCommits(std::uint32_t count)
+   {
+      std::lock_guard l{impl->subjectiveMutex};
+      impl->failSubjectiveCommits = count;
+   }
+
    bool SharedDatabase::isSlow() const
    {
       return impl->trie->is_slow();
@@ -742,6 +981,10 @@ namespace psibase
                                   subjectiveRevisions.empty() ? nullptr : &socketChanges,
                                   callbacks->socketP2P);
       }
+      std::size_t subjectiveDepth() const
+      {
+         return subjectiveRevisions.empty() ? 0 : subjectiveRevisions.size() - 1;
+      }
       std::size_t saveSubjective()
       {
          auto result     = subjectiveLimit;
@@ -900,6 +1143,10 @@ namespace psibase
    {
       return impl->socketEnableP2P(socket, sockets, closing);
    }
+   std::size_t Database::subjectiveDepth() const
+   {
+      return impl->subjectiveDepth();
+   }
    std::size_t Database::saveSubjective()
    {
       return impl->saveSubjective();
@@ -940,6 +1187,32 @@ namespace psibase
           });
    }
 
+   void Database::kvReplaceRangeRaw(DbId                      db,
+                                    psio::input_stream        low,
+                                    psio::input_stream        high,
+                                    std::span<const KVResult> rows)
+   {
+      check(!impl->getChangeSet(db), "kvReplaceRangeRaw does not support subjective databases");
+      if (!rows.empty())
+      {
+         check(rows.front().key.string_view() >= low.string_view() &&
+                   (high.remaining() == 0 || rows.back().key.string_view() < high.string_view()),
+               "kvReplaceRangeRaw: row is outside the range");
+      }
+      impl->write(
+          [&](auto& session, auto& revision)
+          {
+             // bulk_build verifies that the rows are sorted
+             auto replacement = session.bulk_build(
+                 rows | std::views::transform(
+                            [](const KVResult& row) {
+                               return std::pair{row.key.string_view(), row.value.string_view()};
+                            }));
+             session.splice(impl->db(revision, db), replacement, low.string_view(),
+                            high.string_view());
+          });
+   }
+
    std::optional<psio::input_stream> Database::kvGetRaw(DbId db, psio::input_stream key)
    {
       return impl->read(
@@ -960,6 +1233,50 @@ namespace psibase
           });
    }  // Database::kvGetRaw
 
+   bool Database::kvExistsRaw(DbId db, psio::input_stream key)
+   {
+      return impl->read(
+          [&](auto& session, auto& revision)
+          {
+             if (auto* changes = impl->getChangeSet(db))
+             {
+                changes->onRead(key.string_view());
+             }
+
+             return session.get(impl->db(revision, db), key.string_view(), nullptr, nullptr);
+          });
+   }  // Database::kvExistsRaw
+
+   std::optional<std::uint32_t> Database::kvGetInto(DbId               db,
+                                                    psio::input_stream key,
+                                                    std::span<char>    dest,
+                                                    std::vector<char>& overflow)
+   {
+      return impl->read(
+          [&](auto& session, auto& revision) -> std::optional<std::uint32_t>
+          {
+             if (auto* changes = impl->getChangeSet(db))
+             {
+                changes->onRead(key.string_view());
+             }
+
+             std::uint32_t size  = 0;
+             auto          found = session.get_value(  //
+                 impl->db(revision, db), key.string_view(),
+                 [&](std::span<const char> value)
+                 {
+                    size = value.size();
+                    if (size <= dest.size())
+                       std::ranges::copy(value, dest.begin());
+                    else
+                       overflow.assign(value.begin(), value.end());
+                 });
+             if (!found)
+                return {};
+             return size;
+          });
+   }  // Database::kvGetInto
+
    std::optional<Database::KVResult> Database::kvGreaterEqualRaw(DbId               db,
                                                                  psio::input_stream key,
                                                                  size_t             matchKeySize)
@@ -1036,6 +1353,96 @@ namespace psibase
           });
    }  // Database::kvMaxRaw
 
+   struct Database::KVIterator::Impl
+   {
+      // The cursor refers to the session, so it must be kept alive
+      std::shared_ptr<triedent::read_session> session;
+      triedent::cursor                        cursor;
+      DbChangeSet*                            changes;
+      std::vector<char>                       prefix;
+      std::vector<char>                       keyBuffer;
+      std::vector<char>                       valueBuffer;
+      std::vector<char>                       searchKey;
+
+      Impl(std::shared_ptr<triedent::read_session> session,
+           const DbPtr&                            root,
+           DbChangeSet*                            changes)
+          : session(std::move(session)), cursor(*this->session, root), changes(changes)
+      {
+      }
+
+      // Records the same range as kvGreaterEqualRaw(searchKey)
+      std::optional<KVResult> greaterEqual()
+      {
+         auto found = result();
+         if (changes)
+            changes->onGreaterEqual(searchKey, prefix.size(), found.has_value(), keyBuffer);
+         return found;
+      }
+
+      std::optional<KVResult> result()
+      {
+         if (!cursor.valid())
+            return {};
+         cursor.key(keyBuffer);
+         if (keyBuffer.size() < prefix.size() ||
+             !std::equal(prefix.begin(), prefix.end(), keyBuffer.begin()))
+            return {};
+         cursor.value(&valueBuffer, nullptr);
+         return {{{keyBuffer}, {valueBuffer}}};
+      }
+   };
+
+   Database::KVIterator::KVIterator(std::unique_ptr<Impl> impl) : impl(std::move(impl)) {}
+   Database::KVIterator::KVIterator(KVIterator&&) = default;
+   Database::KVIterator::~KVIterator()            = default;
+
+   std::optional<Database::KVResult> Database::KVIterator::seek(psio::input_stream key,
+                                                                size_t             matchKeySize)
+   {
+      impl->prefix.assign(key.pos, key.pos + std::min(matchKeySize, key.remaining()));
+      impl->searchKey.assign(key.pos, key.end);
+      impl->cursor.lower_bound(key.string_view());
+      return impl->greaterEqual();
+   }
+
+   // The key that the cursor was on is still in keyBuffer
+   std::optional<Database::KVResult> Database::KVIterator::next()
+   {
+      if (impl->changes)
+      {
+         impl->searchKey = impl->keyBuffer;
+         impl->searchKey.push_back(0);
+      }
+      impl->cursor.next();
+      return impl->greaterEqual();
+   }
+
+   std::optional<Database::KVResult> Database::KVIterator::prev()
+   {
+      if (impl->changes)
+         impl->searchKey = impl->keyBuffer;
+      impl->cursor.prev();
+      auto found = impl->result();
+      if (impl->changes)
+         impl->changes->onLessThan(impl->searchKey, impl->prefix.size(), found.has_value(),
+                                   impl->keyBuffer);
+      return found;
+   }
+
+   Database::KVIterator Database::kvIterator(DbId db)
+   {
+      std::shared_ptr<triedent::read_session> session = impl->readSession;
+      if (!session)
+         session = impl->writeSession;
+      return impl->read(
+          [&](auto&, auto& revision)
+          {
+             return KVIterator{std::make_unique<KVIterator::Impl>(
+                 std::move(session), impl->db(revision, db), impl->getChangeSet(db))};
+          });
+   }  // Database::kvIterator
+
    void Database::setCallbackFlags(DatabaseCallbacks::Flags flags)
    {
       impl->callbackFlags |= flags;
@@ -0,0 +1,157 @@
+#include <psibase/KvMerkle.hpp>
+#include <psibase/db.hpp>
+
+#include <filesystem>
+#include <random>
+#include <thread>
+
+#include <catch2/catch_all.hpp>
+
+using namespace psibase;
+
+namespace
+{
+   struct TempDirectory
+   {
+      TempDirectory()
+          : path(std::filesystem::temp_directory_path() /
+                 ("psibase-checksum-" + std::to_string(std::random_device{}())))
+      {
+         std::filesystem::create_directory(path);
+      }
+      ~TempDirectory() { std::filesystem::remove_all(path); }
+      std::filesystem::path path;
+   };
+
+   SharedDatabase makeDatabase(const TempDirectory& dir)
+   {
+      std::uint64_t size = 1ull << 30;
+      return SharedDatabase{dir.path / "db", triedent::database_config{size, size, size, size}};
+   }
+
+   // Writes rows whose keys look like table rows: a service, a table
+   // prefix, and a row key of varying length. Every fourth key removes
+   // the next row instead.
+   ConstRevisionPtr fill(SharedDatabase&  shared,
+                         ConstRevisionPtr base,
+                         std::size_t      numRows,
+                         std::uint32_t    seed)
+   {
+      std::mt19937                       gen(seed);
+      std::uniform_int_distribution<int> services(0, 15);
+      std::uniform_int_distribution<int> len(0, 12);
+      std::uniform_int_distribution<int> ch(0, 255);
+      std::uniform_int_distribution<int> valueLen(0, 64);
+      Database                           db{shared, std::move(base)};
+      auto                               session = db.startWrite(shared.createWriter());
+      std::vector<char>                  key, value;
+      for (std::size_t i = 0; i < numRows; ++i)
+      {
+         key.assign(8, 0);
+         key[7] = static_cast<char>(services(gen));
+         key.push_back(static_cast<char>(i % 3));
+         key.resize(key.size() + len(gen));
+         for (auto& c : std::span{key}.subspan(9))
+            c = static_cast<char>(ch(gen));
+         if (i % 4 == 3)
+         {
+            if (auto row = db.kvGreaterEqualRaw(DbId::service, key, 0))
+            {
+               key.assign(row->key.pos, row->key.end);
+               db.kvRemoveRaw(DbId::service, key);
+            }
+            continue;
+         }
+         value.resize(valueLen(gen));
+         for (auto& c : value)
+            c = static_cast<char>(ch(gen));
+         db.kvPutRaw(DbId::service, key, value);
+      }
+      // Keys that are prefixes of the keys above
+      key.resize(8);
+      db.kvPutRaw(DbId::service, {}, value);
+      db.kvPutRaw(DbId::service, key, value);
+      return db.getModifiedRevision();
+   }
+
+   Checksum256 sequentialRoot(SharedDatabase& shared, const ConstRevisionPtr& revision)
+   {
+      Database       db{shared, revision};
+      auto           session = db.startRead();
+      KvMerkle       merkle;
+      KvMerkle::Item item{{}, {}};
+      auto           iter = db.kvIterator(DbId::service);
+      for (auto kv = iter.seek({}, 0); kv; kv = iter.next())
+      {
+         item.from(kv->key, kv->value);
+         merkle.push(item);
+      }
+      return std::move(merkle).root();
+   }
+}  // namespace
+
+TEST_CASE("kvMerkleRoot")
+{
+   TempDirectory dir;
+   auto          shared = makeDatabase(dir);
+
+   CHECK(shared.kvMerkleRoot(shared.emptyRevision(), DbId::service, 4) == Checksum256{});
+
+   auto numRows  = GENERATE(1, 10, 5000);
+   auto revision = fill(shared, shared.emptyRevision(), numRows, numRows);
+   auto expected = sequentialRoot(shared, revision);
+   for (std::size_t numThreads : {1, 2, 3, 8})
+   {
+      INFO("threads: " << numThreads);
+      CHECK(shared.kvMerkleRoot(revision, DbId::service, numThreads) == expected);
+   }
+}
+
+TEST_CASE("kvMerkleRoot cache")
+{
+   TempDirectory dir;
+   auto          shared = makeDatabase(dir);
+   shared.enableKvMerkleCache();
+
+   CHECK(shared.kvMerkleRoot(shared.emptyRevision(), DbId::service, 1) == Checksum256{});
+
+   auto revision = fill(shared, shared.emptyRevision(), 5000, 0);
+   CHECK(shared.kvMerkleRoot(revision, DbId::service, 1) == sequentialRoot(shared, revision));
+   for (std::uint32_t i = 1; i <= 20; ++i)
+   {
+      INFO("revision " << i);
+      revision = fill(shared, revision, i * 10, i);
+      CHECK(shared.kvMerkleRoot(revision, DbId::service, 1) == sequentialRoot(shared, revision));
+   }
+}
+
+TEST_CASE("kvMerkleRoot benchmark", "[.][benchmark]")
+{
+   TempDirectory dir;
+   auto          shared     = makeDatabase(dir);
+   auto          revision   = fill(shared, shared.emptyRevision(), 2'000'000, 0);
+   std::size_t   numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+   REQUIRE(shared.kvMerkleRoot(revision, DbId::service, numThreads) ==
+           sequentialRoot(shared, revision));
+
+   BENCHMARK("sequential")
+   {
+      return sequentialRoot(shared, revision);
+   };
+   BENCHMARK("parallel")
+   {
+      return shared.kvMerkleRoot(revision, DbId::service, numThreads);
+   };
+
+   // Alternates between two revisions that differ by 1000 rows
+   ConstRevisionPtr revisions[] = {revision, fill(shared, revision, 1000, 1)};
+   shared.enableKvMerkleCache();
+   CHECK(shared.kvMerkleRoot(revisions[1], DbId::service, numThreads) ==
+         sequentialRoot(shared, revisions[1]));
+   std::size_t i = 0;
+   BENCHMARK("cached, 1000 rows changed")
+   {
+      return shared.kvMerkleRoot(revisions[i++ % 2], DbId::service, numThreads);
+   };
+}
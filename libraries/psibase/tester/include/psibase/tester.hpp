@@ -591,6 +591,14 @@ namespace psibase
        * a transaction, returns its trace.
        */
       std::optional<TransactionTrace> pushNextTransaction();
+      /**
+       * Runs the nextTransactions callback to find up to
+       * maxCount transactions and pushes all of them.
+       * Falls back to pushNextTransaction if no service
+       * registered nextTransactions. Returns the traces of
+       * the transactions that were pushed.
+       */
+      std::vector<TransactionTrace> pushNextTransactions(std::uint32_t maxCount);
       /**
        * Reads the first RunRow and executes it. Returns true
        * if there was anything to do.
@@ -598,7 +606,7 @@ namespace psibase
       bool runQueueItem();
       /**
        * Runs pending work to completion.
-       * - pushNextTransaction
+       * - pushNextTransactions
        * - runQueueItem
        */
       void runAll();
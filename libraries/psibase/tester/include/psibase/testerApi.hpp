@@ -95,9 +95,27 @@ namespace psibase::tester::raw
    TESTER_NATIVE(kvRemove)
    void kvRemove(std::uint32_t chain, psibase::DbId db, const char* key, std::uint32_t keyLen);
 
+   // Replaces all rows in [low, high) with rows. If high is empty, the range
+   // has no upper bound. rows holds each row as a u32 key size, the key, a u32
+   // value size, and the value. The keys must be in increasing order and must be
+   // inside the range. The subjective databases are not supported.
+   TESTER_NATIVE(kvReplaceRange)
+   void kvReplaceRange(std::uint32_t chain,
+                       psibase::DbId db,
+                       const char*   low,
+                       std::uint32_t lowLen,
+                       const char*   high,
+                       std::uint32_t highLen,
+                       const char*   rows,
+                       std::uint32_t rowsLen);
+
    TESTER_NATIVE(checkoutSubjective) void checkoutSubjective(std::uint32_t chain);
    TESTER_NATIVE(commitSubjective) bool commitSubjective(std::uint32_t chain);
    TESTER_NATIVE(abortSubjective) void abortSubjective(std::uint32_t chain);
+   // The next count subjective commits that have changes fail, which makes
+   // PSIBASE_SUBJECTIVE_TX run its body again
+   TESTER_NATIVE(failSubjectiveCommits)
+   void failSubjectiveCommits(std::uint32_t chain, std::uint32_t count);
 
    TESTER_NATIVE(commitState)
    void commitState(std::uint32_t chain);
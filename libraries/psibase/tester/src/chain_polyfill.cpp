@@ -1,6 +1,8 @@
 #include <psibase/api.hpp>
 #include <psibase/testerApi.hpp>
 
+#include <cstring>
+
 using namespace psibase;
 using std::uint32_t;
 
@@ -88,6 +90,20 @@ uint32_t psibase::raw::kvGet(KvHandle db, const char* key, uint32_t keyLen)
                                       fullKey.data(), fullKey.size());
 }
 
+uint32_t psibase::raw::kvGetInto(KvHandle    db,
+                                 const char* key,
+                                 uint32_t    keyLen,
+                                 char*       dest,
+                                 uint32_t    destSize)
+{
+   auto size = psibase::raw::kvGet(db, key, keyLen);
+   if (size != -1 && size <= destSize)
+   {
+      psibase::raw::getResult(dest, size, 0);
+   }
+   return size;
+}
+
 uint32_t psibase::raw::kvGreaterEqual(KvHandle    db,
                                       const char* key,
                                       uint32_t    keyLen,
@@ -100,6 +116,42 @@ uint32_t psibase::raw::kvGreaterEqual(KvHandle    db,
                                                bucket->prefix.size() + matchKeySize);
 }
 
+uint32_t psibase::raw::kvScan(KvHandle    db,
+                              const char* key,
+                              uint32_t    keyLen,
+                              uint32_t    matchKeySize,
+                              uint32_t    maxRows,
+                              char*       dest,
+                              uint32_t    destSize)
+{
+   std::vector<char> next(key, key + keyLen);
+   std::uint64_t     used = 0;
+   std::uint32_t     rows = 0;
+   for (; rows < maxRows; ++rows)
+   {
+      auto valueSize = psibase::raw::kvGreaterEqual(db, next.data(), next.size(), matchKeySize);
+      if (valueSize == -1)
+         break;
+      auto          keySize = psibase::raw::getKey(nullptr, 0);
+      std::uint64_t rowSize = 8 + std::uint64_t{keySize} + valueSize;
+      if (used + rowSize > destSize)
+      {
+         if (rows == 0)
+            return rowSize;
+         break;
+      }
+      auto pos = dest + used;
+      std::memcpy(pos, &keySize, 4);
+      psibase::raw::getKey(pos + 4, keySize);
+      std::memcpy(pos + 4 + keySize, &valueSize, 4);
+      psibase::raw::getResult(pos + 8 + keySize, valueSize, 0);
+      next.assign(pos + 4, pos + 4 + keySize);
+      next.push_back(0);
+      used += rowSize;
+   }
+   return rows == 0 ? -1 : used;
+}
+
 uint32_t psibase::raw::kvLessThan(KvHandle    db,
                                   const char* key,
                                   uint32_t    keyLen,
@@ -724,6 +724,40 @@ std::optional<psibase::TransactionTrace> psibase::TestChain::pushNextTransaction
    return {};
 }
 
+std::vector<psibase::TransactionTrace> psibase::TestChain::pushNextTransactions(
+    std::uint32_t maxCount)
+{
+   std::vector<TransactionTrace> result;
+   if (auto row =
+           kvGet<NotifyRow>(DbId::nativeSubjective, notifyKey(NotifyType::nextTransactions)))
+   {
+      for (auto& act : row->actions)
+      {
+         check(act.sender == AccountNumber{} && act.rawData.empty(),
+               "Invalid nextTransactions callback");
+         act.rawData = psio::to_frac(std::tuple(maxCount));
+         auto trace  = tester::runAction(id, RunMode::callback, false, act);
+         if (trace.error)
+            abortMessage("nextTransactions failed:\n" + prettyTrace(trace));
+         check(trace.actionTraces.size() == 1, "Wrong number of action traces");
+         auto trxs = psio::from_frac<std::vector<SignedTransaction>>(
+             trace.actionTraces.front().rawRetval);
+         check(trxs.size() <= maxCount, "nextTransactions returned too many transactions");
+         if (!trxs.empty())
+         {
+            for (const auto& trx : trxs)
+               result.push_back(pushTransaction(trx));
+            break;
+         }
+      }
+   }
+   else if (auto trace = pushNextTransaction())
+   {
+      result.push_back(std::move(*trace));
+   }
+   return result;
+}
+
 bool psibase::TestChain::runQueueItem()
 {
    if (auto row = kvGreaterEqual<RunRow>(RunRow::db, runPrefix(),
@@ -748,9 +782,15 @@ bool psibase::TestChain::runQueueItem()
    }
 }
 
+namespace
+{
+   // The same batch size that the block producer uses
+   constexpr std::uint32_t maxTransactionBatch = 32;
+}  // namespace
+
 void psibase::TestChain::runAll()
 {
-   while (pushNextTransaction() || runQueueItem())
+   while (!pushNextTransactions(maxTransactionBatch).empty() || runQueueItem())
    {
    }
 }
@@ -12,9 +12,7 @@ void psibase::http::callClose(const server_state&     server,
    psio::finally f{[&]() { server.sharedState->addSystemContext(std::move(system)); }};
    if (socket.notifyClose)
    {
-      BlockContext bc{*system, system->sharedDatabase.getHead(),
-                      system->sharedDatabase.createWriter(), true};
-      bc.start();
+      BlockContext& bc = getQueryContext(*system, system->sharedDatabase.getHead());
 
       SignedTransaction trx;
       TransactionTrace  trace;
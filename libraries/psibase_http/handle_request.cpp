@@ -13,6 +13,7 @@
 #include <psibase/Socket.hpp>
 #include <psibase/TransactionContext.hpp>
 #include <psibase/WebSocket.hpp>
+#include <psibase/response_cache.hpp>
 #include <psibase/serviceEntry.hpp>
 #include <psio/finally.hpp>
 #include <psio/to_json.hpp>
@@ -136,6 +137,28 @@ namespace psibase::http
       return std::vector(s.begin(), s.end());
    }
 
+   // Returns the service that was running when the action failed
+   AccountNumber failedService(const ActionTrace& atrace)
+   {
+      const ActionTrace* current = &atrace;
+      while (true)
+      {
+         const ActionTrace* next = nullptr;
+         for (auto iter = current->innerTraces.rbegin(); iter != current->innerTraces.rend();
+              ++iter)
+         {
+            if (auto* inner = std::get_if<ActionTrace>(&iter->inner))
+            {
+               next = inner;
+               break;
+            }
+         }
+         if (!next || !next->error)
+            return current->action.service;
+         current = next;
+      }
+   }
+
    struct QueryTimes
    {
       std::chrono::microseconds             packTime;
@@ -270,6 +293,52 @@ namespace psibase::http
          return res;
       }
 
+      // Converts the reply sent by a service
+      auto reply(HttpReply&& reply) const
+      {
+         bhttp::response<bhttp::vector_body<char>> res{
+             bhttp::int_to_status(static_cast<std::uint16_t>(reply.status)), req_version};
+         res.set(bhttp::field::server, BOOST_BEAST_VERSION_STRING);
+         for (auto& h : reply.headers)
+            res.set(h.name, h.value);
+         res.set(bhttp::field::content_type, reply.contentType);
+         setKeepAlive(res);
+         res.body() = std::move(reply.body);
+         res.prepare_payload();
+         return res;
+      }
+
+      // Returns a reply from the response cache, or 304 if the
+      // client's copy is current.
+      auto cached(const response_cache::entry& entry,
+                  bool                         head,
+                  std::string_view             if_none_match) const
+      {
+         bool notModified = entry.etag && !if_none_match.empty() &&
+                            response_cache::etag_matches(if_none_match, *entry.etag);
+         bhttp::response<bhttp::vector_body<char>> res{
+             notModified ? bhttp::status::not_modified : bhttp::status::ok, req_version};
+         res.set(bhttp::field::server, BOOST_BEAST_VERSION_STRING);
+         if (notModified)
+         {
+            // A 304 has no content, so the headers that describe it are left out
+            for (auto& h : entry.reply.headers)
+               if (response_cache::is_not_modified_header(h))
+                  res.set(h.name, h.value);
+         }
+         else
+         {
+            for (auto& h : entry.reply.headers)
+               res.set(h.name, h.value);
+            res.set(bhttp::field::content_type, entry.reply.contentType);
+            if (!head)
+               res.body() = entry.reply.body;
+         }
+         setKeepAlive(res);
+         res.prepare_payload();
+         return res;
+      }
+
       auto accepted() const
       {
          bhttp::response<bhttp::vector_body<char>> res{bhttp::status::accepted, req_version};
@@ -317,6 +386,15 @@ namespace psibase::http
                autoCloseImpl("query failed: unknown exception\n");
             }
          }
+         else if (!message && timeoutStatus)
+         {
+            sendImpl(
+                [status = *timeoutStatus](HttpSocket* self)
+                {
+                   return HttpReplyBuilder{self->session->server, self->req}.error(
+                       status, "The query exceeded its CPU time limit");
+                });
+         }
          else
          {
             autoCloseImpl(std::move(message).value_or("service did not send a response"));
@@ -731,6 +809,19 @@ namespace psibase::http
             }
             runNativeHandlerNoContent(server.http_config->lock_keyring);
          }
+         else if (req_target == "/native/admin/prewarm" && server.http_config->prewarm)
+         {
+            if (req.method() != bhttp::verb::post)
+            {
+               return send(builder.methodNotAllowed(req.target(), req.method_string(), "POST"));
+            }
+            if (req[bhttp::field::content_type] != "application/json")
+            {
+               return send(builder.error(bhttp::status::unsupported_media_type,
+                                         "Content-Type must be application/json\n"));
+            }
+            runNativeHandlerNoContent(server.http_config->prewarm);
+         }
          else
          {
             return send(builder.notFound(req.target()));
@@ -744,6 +835,8 @@ namespace psibase::http
       TransactionTrace                   trace;
       QueryTimes                         queryTimes;
       std::atomic<bool>                  replySent{false};
+      // Set if the query ran out of CPU time before replying
+      std::optional<bhttp::status> timeoutStatus;
    };
 
    template <typename F, typename E>
@@ -812,32 +905,63 @@ namespace psibase::http
             data.contentType = (std::string)req[bhttp::field::content_type];
             data.body        = req.body();
 
+            auto queryTimeout = server.http_config->query_timeout_us.load();
+
             // Do not use any reconfigurable members of server.http_config after this point
             l.unlock();
 
-            // TODO: time limit
             auto system = server.sharedState->getSystemContext();
 
             psio::finally f{[&]() { server.sharedState->addSystemContext(std::move(system)); }};
-            BlockContext  bc{*system, system->sharedDatabase.getHead(),
-                            system->sharedDatabase.createWriter(), true};
-            bc.start();
+            auto head = system->sharedDatabase.getHead();
 
-            auto socket = makeHttpSocket(
+            // Replies that a service marked as reusable are served without running wasm
+            const auto&                             cache = server.http_config->reply_cache;
+            std::optional<response_cache::key_type> cacheKey;
+            IndependentRevision                     subjective;
+            if (cache && (data.method == "GET" || data.method == "HEAD"))
+            {
+               cacheKey = response_cache::key_type{
+                   .host            = std::string(req_host),
+                   .target          = data.target,
+                   .accept_encoding = std::string(req[bhttp::field::accept_encoding]),
+               };
+               // A hit must not start a query context, so borrow the writer of an
+               // existing one if there is one.
+               auto writer = system->queryContext ? system->queryContext->writer
+                                                  : system->sharedDatabase.createWriter();
+               subjective  = system->sharedDatabase.getSubjective();
+               if (auto entry =
+                       cache->find(*cacheKey, system->sharedDatabase, *writer, head, subjective))
+               {
+                  auto ifNoneMatch = req[bhttp::field::if_none_match];
+                  return send(builder.cached(*entry, data.method == "HEAD",
+                                             {ifNoneMatch.data(), ifNoneMatch.size()}));
+               }
+               // HEAD replies have no body, so only GET replies are stored
+               if (data.method != "GET")
+                  cacheKey.reset();
+            }
+
+            BlockContext& bc     = getQueryContext(*system, head);
+            auto          socket = makeHttpSocket(
                 std::move(req), send,
-                [builder](HttpReply&& reply)
+                [builder, cache, cacheKey = std::move(cacheKey), revision = std::move(head),
+                 subjective = std::move(subjective)](HttpReply&& reply) mutable
                 {
-                   bhttp::response<bhttp::vector_body<char>> res{
-                       bhttp::int_to_status(static_cast<std::uint16_t>(reply.status)),
-                       builder.req_version};
-                   res.set(bhttp::field::server, BOOST_BEAST_VERSION_STRING);
-                   for (auto& h : reply.headers)
-                      res.set(h.name, h.value);
-                   res.set(bhttp::field::content_type, reply.contentType);
-                   builder.setKeepAlive(res);
-                   res.body() = std::move(reply.body);
-                   res.prepare_payload();
-                   return res;
+                   auto depends = response_cache::parse_depends(reply);
+                   response_cache::strip_header(reply);
+                   if (depends && cacheKey && reply.status == HttpStatus::ok)
+                   {
+                      auto etag = reply.getHeader("ETag");
+                      cache->insert(std::move(*cacheKey),
+                                    {.reply   = reply,
+                                     .etag    = etag ? std::optional{std::string(*etag)}
+                                                     : std::nullopt,
+                                     .depends = std::move(*depends)},
+                                    std::move(revision), std::move(subjective));
+                   }
+                   return builder.reply(std::move(reply));
                 },
                 [builder](const std::string& message)
                 { return builder.error(bhttp::status::internal_server_error, message); });
@@ -849,6 +973,9 @@ namespace psibase::http
                auto               startExecTime = steady_clock::now();
 
                system->sockets->add(*bc.writer, socket, &tc.ownedSockets);
+               if (queryTimeout >= 0)
+                  tc.setWatchdog(std::chrono::duration_cast<CpuClock::duration>(
+                      std::chrono::microseconds{queryTimeout}));
                // these can't throw and should run iff sockets->add succeeds
                send.pause_read = true;
                auto setStatus  = psio::finally(
@@ -879,6 +1006,18 @@ namespace psibase::http
                   };
                   tc.execServe(action, atrace);
                }
+               catch (TimeoutException& e)
+               {
+                  socket->trace.error = e.what();
+                  // A timeout in the proxy means that the node could not even route the
+                  // request. A timeout in the service that handles the request means that
+                  // the upstream service did not respond in time.
+                  auto service = failedService(atrace);
+                  server.http_config->query_timeouts.add(service);
+                  socket->timeoutStatus = service == proxyServiceNum
+                                              ? bhttp::status::service_unavailable
+                                              : bhttp::status::gateway_timeout;
+               }
                catch (std::exception& e)
                {
                   socket->trace.error = e.what();
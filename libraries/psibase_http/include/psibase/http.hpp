@@ -9,6 +9,8 @@
 #include <boost/type_erasure/callable.hpp>
 #include <chrono>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <psibase/SystemContext.hpp>
 #include <psibase/trace.hpp>
 #include <shared_mutex>
@@ -52,6 +54,8 @@ namespace psibase::http
    using unlock_keyring_t = connect_t;
    using lock_keyring_t   = connect_t;
 
+   using prewarm_t = connect_t;
+
    using get_pkcs11_tokens_t = std::function<void(generic_json_callback)>;
 
    struct http_status
@@ -210,11 +214,36 @@ namespace psibase::http
    using tls_context_ptr = std::shared_ptr<boost::asio::ssl::context>;
 #endif
 
+   class response_cache;
+
+   // Counts the queries that ran out of CPU time, by the service
+   // that was running when the limit was reached
+   class query_timeout_counter
+   {
+     public:
+      void add(AccountNumber service)
+      {
+         std::lock_guard l{mutex};
+         ++counts[service];
+      }
+      std::vector<std::pair<AccountNumber, std::uint64_t>> get() const
+      {
+         std::lock_guard l{mutex};
+         return {counts.begin(), counts.end()};
+      }
+
+     private:
+      mutable std::mutex                     mutex;
+      std::map<AccountNumber, std::uint64_t> counts;
+   };
+
    struct http_config
    {
       uint32_t                 num_threads      = {};
       uint32_t                 max_request_size = {};
       std::atomic<int64_t>     idle_timeout_us  = {};
+      // The CPU time that a query may use. Negative means no limit.
+      std::atomic<int64_t>     query_timeout_us = -1;
       std::vector<listen_spec> listen           = {};
 #ifdef PSIBASE_ENABLE_SSL
       tls_context_ptr tls_context = {};
@@ -227,8 +256,12 @@ namespace psibase::http
       unlock_keyring_t    unlock_keyring    = {};
       lock_keyring_t      lock_keyring      = {};
       get_pkcs11_tokens_t get_pkcs11_tokens = {};
+      prewarm_t           prewarm           = {};
+      // Replies that services marked as reusable. Null disables caching.
+      std::shared_ptr<response_cache> reply_cache = {};
       // This contains some cached state that the reader thread might modify
       mutable std::atomic<http_status> status;
+      mutable query_timeout_counter    query_timeouts;
 
       mutable std::shared_mutex mutex;
    };
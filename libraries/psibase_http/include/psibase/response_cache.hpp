@@ -0,0 +1,126 @@
+#pragma once
+
+#include <psibase/AccountNumber.hpp>
+#include <psibase/Rpc.hpp>
+#include <psibase/db.hpp>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace psibase::http
+{
+   // A service allows psinode to reuse a GET reply by setting this header.
+   // The value is a comma-separated list of the services whose tables the
+   // reply was built from. An empty value means that the reply may only
+   // be reused until the head block changes. The header is never
+   // forwarded to the client.
+   //
+   // The reply must depend only on the host, the target, Accept-Encoding,
+   // and the chain state.
+   inline constexpr std::string_view response_cache_header = "Psibase-Cache";
+
+   // Holds replies that were marked with response_cache_header.
+   //
+   // An entry stays valid across blocks as long as the tables and the code
+   // of the services that it depends on are unchanged, and the code of
+   // x-http, http-server, and sites is unchanged. Because x-http server
+   // registrations and local services can take over a request, an entry
+   // is also dropped when x-http's subjective tables or the subjective
+   // native tables change. The host configuration is not tracked. The
+   // owner must clear the cache when it changes.
+   //
+   // When the cache is full, the least recently used entries are evicted.
+   class response_cache
+   {
+     public:
+      struct key_type
+      {
+         std::string host;
+         std::string target;
+         std::string accept_encoding;
+
+         friend auto operator<=>(const key_type&, const key_type&) = default;
+      };
+
+      struct entry
+      {
+         HttpReply                  reply;
+         std::optional<std::string> etag;
+         // If empty, the entry is only valid at the revision that produced it
+         std::vector<AccountNumber> depends;
+      };
+
+      struct stats
+      {
+         std::uint64_t hits;
+         std::uint64_t misses;
+         std::uint64_t evictions;
+         std::uint64_t entries;
+         std::uint64_t bytes;
+      };
+
+      explicit response_cache(std::size_t max_bytes);
+
+      // Returns nullopt if the header is missing or names an invalid account
+      static std::optional<std::vector<AccountNumber>> parse_depends(const HttpReply& reply);
+
+      // Removes response_cache_header from the reply
+      static void strip_header(HttpReply& reply);
+
+      // Returns true if an If-None-Match value matches etag. This uses the
+      // weak comparison that RFC 9110 requires for If-None-Match.
+      static bool etag_matches(std::string_view if_none_match, std::string_view etag);
+
+      // Returns true if a header of a cached reply is also sent with a 304
+      static bool is_not_modified_header(const HttpHeader& header);
+
+      // Returns the entry if it is still valid at head and subjective
+      std::shared_ptr<const entry> find(const key_type&            key,
+                                        SharedDatabase&            db,
+                                        Writer&                    writer,
+                                        const ConstRevisionPtr&    head,
+                                        const IndependentRevision& subjective);
+
+      // revision and subjective are the state that the reply was generated from
+      void  insert(key_type            key,
+                   entry&&             value,
+                   ConstRevisionPtr    revision,
+                   IndependentRevision subjective);
+      void  clear();
+      stats get_stats();
+
+     private:
+      using lru_list = std::list<const key_type*>;
+      struct slot
+      {
+         std::shared_ptr<const entry> value;
+         ConstRevisionPtr             revision;
+         IndependentRevision          subjective;
+         std::size_t                  size;
+         lru_list::iterator           lru_pos;
+      };
+      using map_type = std::map<key_type, slot>;
+
+      void erase(map_type::iterator pos);
+      // Removes an entry that is stale. Does nothing if it was already replaced.
+      void invalidate(const key_type& key, const std::shared_ptr<const entry>& value);
+
+      std::mutex    mutex;
+      map_type      entries;
+      // Most recently used first
+      lru_list      lru;
+      std::size_t   max_bytes;
+      std::size_t   total_bytes = 0;
+      std::uint64_t hits        = 0;
+      std::uint64_t misses      = 0;
+      std::uint64_t evictions   = 0;
+   };
+
+}  // namespace psibase::http
@@ -0,0 +1,276 @@
+#include <psibase/response_cache.hpp>
+
+#include <psibase/nativeTables.hpp>
+#include <psio/to_key.hpp>
+
+#include <algorithm>
+
+namespace psibase::http
+{
+   namespace
+   {
+      std::size_t entrySize(const response_cache::key_type& key, const HttpReply& reply)
+      {
+         std::size_t result = sizeof(response_cache::entry) + key.host.size() +
+                              key.target.size() + key.accept_encoding.size() +
+                              reply.contentType.size() + reply.body.size();
+         for (const auto& h : reply.headers)
+            result += sizeof(HttpHeader) + h.name.size() + h.value.size();
+         return result;
+      }
+
+      // The x-http server registrations and the local services decide which
+      // service handles a request.
+      bool routingUnchanged(SharedDatabase&            db,
+                            Writer&                    writer,
+                            const IndependentRevision& r1,
+                            const IndependentRevision& r2)
+      {
+         auto xhttp = AccountNumber{"x-http"};
+         auto lower = psio::convert_to_key(xhttp);
+         auto upper = psio::convert_to_key(AccountNumber{xhttp.value + 1});
+         return db.isUnchanged(writer, r1, r2, DbId::nativeSubjective, {}, {}) &&
+                db.isUnchanged(writer, r1, r2, DbId::subjective, lower, upper);
+      }
+
+      // The services that pass a request on to the service that handles it
+      constexpr AccountNumber proxyServices[] = {AccountNumber{"x-http"},
+                                                 AccountNumber{"http-server"},
+                                                 AccountNumber{"sites"}};
+
+      // A reply also depends on the code of the services that produced it
+      bool codeUnchanged(SharedDatabase&         db,
+                         Writer&                 writer,
+                         const ConstRevisionPtr& r1,
+                         const ConstRevisionPtr& r2,
+                         AccountNumber           service)
+      {
+         auto lower = psio::convert_to_key(codeKey(service));
+         auto upper = lower;
+         upper.push_back(0);
+         return db.isUnchanged(writer, r1, r2, CodeRow::db, lower, upper);
+      }
+
+      // Removes the optional whitespace around list elements
+      void trimOws(std::string_view& s)
+      {
+         while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+         while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+            s.remove_suffix(1);
+      }
+
+      // Returns the opaque-tag of an entity-tag, without the weak indicator
+      std::string_view opaqueTag(std::string_view etag)
+      {
+         if (etag.starts_with("W/"))
+            etag.remove_prefix(2);
+         return etag;
+      }
+   }  // namespace
+
+   response_cache::response_cache(std::size_t max_bytes) : max_bytes(max_bytes) {}
+
+   std::optional<std::vector<AccountNumber>> response_cache::parse_depends(const HttpReply& reply)
+   {
+      if (!reply.getHeader(response_cache_header))
+         return std::nullopt;
+      std::vector<AccountNumber> result;
+      for (auto name : reply.getHeaderValues(response_cache_header))
+      {
+         if (name.empty())
+            continue;
+         AccountNumber account{name};
+         if (account == AccountNumber{} || account.str() != name)
+            return std::nullopt;
+         result.push_back(account);
+      }
+      return result;
+   }
+
+   void response_cache::strip_header(HttpReply& reply)
+   {
+      std::erase_if(reply.headers, [](const auto& h) { return h.matches(response_cache_header); });
+   }
+
+   bool response_cache::etag_matches(std::string_view if_none_match, std::string_view etag)
+   {
+      auto expected = opaqueTag(etag);
+      trimOws(if_none_match);
+      if (if_none_match == "*")
+         return true;
+      // A list of entity-tags. The opaque-tags are quoted and may contain commas.
+      while (!if_none_match.empty())
+      {
+         std::size_t pos = if_none_match.starts_with("W/") ? 2 : 0;
+         if (if_none_match.size() <= pos || if_none_match[pos] != '"')
+            return false;
+         auto end = if_none_match.find('"', pos + 1);
+         if (end == std::string_view::npos)
+            return false;
+         if (opaqueTag(if_none_match.substr(0, end + 1)) == expected)
+            return true;
+         if_none_match.remove_prefix(end + 1);
+         trimOws(if_none_match);
+         if (!if_none_match.empty())
+         {
+            if (if_none_match.front() != ',')
+               return false;
+            if_none_match.remove_prefix(1);
+            trimOws(if_none_match);
+         }
+      }
+      return false;
+   }
+
+   bool response_cache::is_not_modified_header(const HttpHeader& header)
+   {
+      static constexpr std::string_view names[] = {
+          "ETag",
+          "Vary",
+          "Access-Control-Allow-Origin",
+          "Access-Control-Allow-Methods",
+          "Access-Control-Allow-Headers",
+          "Access-Control-Allow-Credentials",
+          "Access-Control-Expose-Headers",
+          "Access-Control-Max-Age",
+      };
+      return std::ranges::any_of(names, [&](auto name) { return header.matches(name); });
+   }
+
+   std::shared_ptr<const response_cache::entry> response_cache::find(
+       const key_type&            key,
+       SharedDatabase&            db,
+       Writer&                    writer,
+       const ConstRevisionPtr&    head,
+       const IndependentRevision& subjective)
+   {
+      std::shared_ptr<const entry> result;
+      ConstRevisionPtr             revision;
+      IndependentRevision          oldSubjective;
+      {
+         std::lock_guard l{mutex};
+         auto            pos = entries.find(key);
+         if (pos == entries.end())
+         {
+            ++misses;
+            return nullptr;
+         }
+         result   = pos->second.value;
+         revision = pos->second.revision;
+         if (revision == head && pos->second.subjective == subjective)
+         {
+            ++hits;
+            lru.splice(lru.begin(), lru, pos->second.lru_pos);
+            return result;
+         }
+         if (revision != head && result->depends.empty())
+         {
+            ++misses;
+            erase(pos);
+            return nullptr;
+         }
+         oldSubjective = pos->second.subjective;
+      }
+
+      if (!routingUnchanged(db, writer, oldSubjective, subjective))
+      {
+         invalidate(key, result);
+         return nullptr;
+      }
+      if (revision != head)
+      {
+         for (AccountNumber service : result->depends)
+         {
+            auto lower = psio::convert_to_key(service);
+            auto upper = psio::convert_to_key(AccountNumber{service.value + 1});
+            if (!db.isUnchanged(writer, revision, head, DbId::service, lower, upper) ||
+                !codeUnchanged(db, writer, revision, head, service))
+            {
+               invalidate(key, result);
+               return nullptr;
+            }
+         }
+         for (AccountNumber service : proxyServices)
+         {
+            if (!codeUnchanged(db, writer, revision, head, service))
+            {
+               invalidate(key, result);
+               return nullptr;
+            }
+         }
+      }
+
+      // Move the entry forward, so that it doesn't keep old revisions
+      // alive and the next lookup at this state is free.
+      std::lock_guard l{mutex};
+      ++hits;
+      if (auto pos = entries.find(key); pos != entries.end() && pos->second.value == result)
+      {
+         pos->second.revision   = head;
+         pos->second.subjective = subjective;
+         lru.splice(lru.begin(), lru, pos->second.lru_pos);
+      }
+      return result;
+   }
+
+   void response_cache::insert(key_type            key,
+                               entry&&             value,
+                               ConstRevisionPtr    revision,
+                               IndependentRevision subjective)
+   {
+      auto size = entrySize(key, value.reply);
+      if (size > max_bytes)
+         return;
+      auto ptr = std::make_shared<const entry>(std::move(value));
+
+      std::lock_guard l{mutex};
+      if (auto pos = entries.find(key); pos != entries.end())
+         erase(pos);
+      while (total_bytes + size > max_bytes)
+      {
+         erase(entries.find(*lru.back()));
+         ++evictions;
+      }
+      total_bytes += size;
+      slot item{std::move(ptr), std::move(revision), std::move(subjective), size};
+      auto pos            = entries.try_emplace(std::move(key), std::move(item)).first;
+      pos->second.lru_pos = lru.insert(lru.begin(), &pos->first);
+   }
+
+   void response_cache::clear()
+   {
+      std::lock_guard l{mutex};
+      entries.clear();
+      lru.clear();
+      total_bytes = 0;
+   }
+
+   response_cache::stats response_cache::get_stats()
+   {
+      std::lock_guard l{mutex};
+      return {
+          .hits      = hits,
+          .misses    = misses,
+          .evictions = evictions,
+          .entries   = entries.size(),
+          .bytes     = total_bytes,
+      };
+   }
+
+   void response_cache::erase(map_type::iterator pos)
+   {
+      total_bytes -= pos->second.size;
+      lru.erase(pos->second.lru_pos);
+      entries.erase(pos);
+   }
+
+   void response_cache::invalidate(const key_type& key, const std::shared_ptr<const entry>& value)
+   {
+      std::lock_guard l{mutex};
+      ++misses;
+      if (auto pos = entries.find(key); pos != entries.end() && pos->second.value == value)
+         erase(pos);
+   }
+
+}  // namespace psibase::http
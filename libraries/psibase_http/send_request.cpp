@@ -171,9 +171,7 @@ namespace
          auto system = self->server.sharedState->getSystemContext();
 
          psio::finally f{[&]() { self->server.sharedState->addSystemContext(std::move(system)); }};
-         BlockContext  bc{*system, system->sharedDatabase.getHead(),
-                          system->sharedDatabase.createWriter(), true};
-         bc.start();
+         BlockContext& bc = getQueryContext(*system, system->sharedDatabase.getHead());
 
          self->writeInfo(*bc.writer);
 
@@ -47,9 +47,7 @@ void WebSocket::handleMessage(CloseLock&& l, bool binary)
    auto system = server.sharedState->getSystemContext();
 
    psio::finally f{[&]() { server.sharedState->addSystemContext(std::move(system)); }};
-   BlockContext bc{*system, system->sharedDatabase.getHead(), system->sharedDatabase.createWriter(),
-                   true};
-   bc.start();
+   BlockContext& bc = getQueryContext(*system, system->sharedDatabase.getHead());
 
    SignedTransaction trx;
    TransactionTrace  trace;
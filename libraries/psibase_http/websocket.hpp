@@ -56,7 +56,7 @@ namespace psibase::http
       };
       struct QueueItem
       {
-         std::vector<char>                           data;
+         net::shared_message                         data;
          std::function<void(const std::error_code&)> callback;
          bool                                        binary = true;
       };
@@ -90,8 +90,8 @@ namespace psibase::http
       {
          if (flags != WebSocketFlags::binary && flags != WebSocketFlags::text)
             abortMessage("Invalid websocket flags: " + std::to_string(flags));
-         std::vector<char> copy(data.begin(), data.end());
-         bool              first;
+         auto copy = std::make_shared<const std::vector<char>>(data.begin(), data.end());
+         bool first;
          {
             std::lock_guard l{mutex};
             if (state != StateType::normal)
@@ -164,7 +164,7 @@ namespace psibase::http
          callback(shared_from_this());
       }
 
-      void async_write(std::vector<char>&&                         data,
+      void async_write(net::shared_message                         data,
                        std::function<void(const std::error_code&)> callback) override
       {
          bool        first;
@@ -172,7 +172,7 @@ namespace psibase::http
          {
             std::lock_guard l{mutex};
             first = impl && outbox.empty();
-            size  = data.size();
+            size  = data->size();
             outbox.push_back({std::move(data), std::move(callback)});
          }
          if (first)
@@ -339,7 +339,7 @@ namespace psibase::http
             }
          }
          stream.binary(item->binary);
-         auto buffer = boost::asio::buffer(item->data);
+         auto buffer = boost::asio::buffer(*item->data);
          stream.async_write(
              buffer,
              [self = std::move(self)](const std::error_code& ec,
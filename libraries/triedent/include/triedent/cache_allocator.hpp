@@ -50,9 +50,15 @@ namespace triedent
       // WARNING: alloc is blocking. It should not be called while
       // holding any locks other than the session. It should also
       // not be called by the swap thread.
+      //
+      // New objects normally go to the hot buffer. Objects that are not
+      // expected to be read soon, such as a large tree that is being
+      // loaded in bulk, can be placed directly in cold storage. level
+      // must be hot_cache or cold_cache.
       std::pair<location_lock, void*> alloc(std::unique_lock<gc_queue::session>& session,
                                             std::size_t                          num_bytes,
-                                            node_type                            type);
+                                            node_type                            type,
+                                            cache_level_type                     level = hot_cache);
 
       std::pair<void*, node_type> release(session_lock_ref<>, id i);
 
@@ -127,14 +133,19 @@ namespace triedent
    inline std::pair<location_lock, void*> cache_allocator::alloc(  //
        std::unique_lock<gc_queue::session>& session,
        std::size_t                          num_bytes,
-       node_type                            type)
+       node_type                            type,
+       cache_level_type                     level)
    {
       if (num_bytes > 0xffffff - 8) [[unlikely]]
          throw std::runtime_error("obj too big");
-
-      object_id i = _obj_ids.alloc(session, type);
-      hot().allocate(session, i, num_bytes,
-                     [&](void*, object_location loc) { _obj_ids.init(i, loc); });
+      assert(level == hot_cache || level == cold_cache);
+
+      object_id i    = _obj_ids.alloc(session, type);
+      auto      init = [&](void*, object_location loc) { _obj_ids.init(i, loc); };
+      if (level == cold_cache)
+         cold().try_allocate(session, i, num_bytes, init);
+      else
+         hot().allocate(session, i, num_bytes, init);
 
       auto lock = _obj_ids.lock(i);
       return {std::move(lock), get_object(_obj_ids.get(i))->data()};
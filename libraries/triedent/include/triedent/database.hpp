@@ -1,8 +1,10 @@
 #pragma once
 
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <optional>
+#include <ranges>
 #include <span>
 #include <triedent/node.hpp>
 
@@ -13,6 +15,11 @@ namespace triedent
    template <typename AccessMode>
    class session;
 
+   class cursor;
+   class diff_iterator;
+   template <typename T>
+   class subtree_cache;
+   struct key_prefix;
    class database;
    class shared_root;
    class write_session;
@@ -168,6 +175,12 @@ namespace triedent
                                            std::vector<std::shared_ptr<root>>* result_roots) const;
       std::optional<std::vector<char>> get(const std::shared_ptr<root>& r,
                                            std::span<const char>        key) const;
+      // Calls f with the value in place, without copying it. The
+      // span is only valid until f returns, because objects may
+      // be moved once the session lock is released. Throws if the
+      // key holds subtrees instead of bytes.
+      template <typename F>
+      bool get_value(const std::shared_ptr<root>& r, std::span<const char> key, F&& f) const;
 
       bool get_greater_equal(const std::shared_ptr<root>&        r,
                              std::span<const char>               key,
@@ -204,6 +217,20 @@ namespace triedent
                          std::span<const char>        lower,
                          std::span<const char>        upper) const;
 
+      // Splits the keys of r at the branches of the inner nodes closest to
+      // the root, until there are at least min_count prefixes or there are
+      // no more inner nodes to split. The prefixes are in key order. Every
+      // key in r either begins with one of the prefixes or is shorter than
+      // the prefix and is a prefix of it.
+      std::vector<key_prefix> split(const std::shared_ptr<root>& r, std::size_t min_count) const;
+
+      // Returns an iterator over the keys in [lower, upper) whose values
+      // are different in r1 and r2. Call first to move to the first key.
+      diff_iterator diff(const std::shared_ptr<root>& r1,
+                         const std::shared_ptr<root>& r2,
+                         std::span<const char>        lower,
+                         std::span<const char>        upper) const;
+
       void print(const std::shared_ptr<root>& r);
       void validate(const std::shared_ptr<root>& r);
 
@@ -223,6 +250,11 @@ namespace triedent
       void             validate(session_lock_ref<> l, id);
       void             print(id n, string_view prefix = "", std::string k = "");
 
+      template <typename F>
+      bool unguarded_find(session_lock_ref<> l,
+                          object_id          root,
+                          std::string_view   key,
+                          F&&                f) const;
       bool unguarded_get(session_lock_ref<>                            l,
                          const std::shared_ptr<triedent::root>&        ancestor,
                          object_id                                     root,
@@ -264,10 +296,22 @@ namespace triedent
                              std::vector<std::shared_ptr<triedent::root>>* result_roots) const;
 
       friend class database;
+      friend class cursor;
+      friend class diff_iterator;
+      template <typename T>
+      friend class subtree_cache;
       std::shared_ptr<database> _db;
    };
    using read_session = session<read_access>;
 
+   // The keys that begin with the first `bits` bits of prefix. The
+   // remaining bits of prefix are 0.
+   struct key_prefix
+   {
+      std::vector<char> prefix;
+      std::size_t       bits;
+   };
+
    class write_session : public read_session
    {
      public:
@@ -302,6 +346,19 @@ namespace triedent
                          std::span<const char>        lower,
                          std::span<const char>        upper);
 
+      // Creates a new tree from rows whose keys are in strictly increasing
+      // order. Each row is a pair of a key and a value that are both
+      // convertible to std::span<const char>.
+      //
+      // This is faster than upserting the rows one at a time. Each node
+      // is written once, after all of its children have been created, and
+      // nothing needs to be searched, cloned, or restructured. The nodes are
+      // allocated directly in cold storage, so that a large tree doesn't
+      // have to be copied through the hot, warm, and cool buffers.
+      //
+      // Throws std::runtime_error if the keys are not in increasing order.
+      std::shared_ptr<root> bulk_build(std::ranges::input_range auto&& rows);
+
       /**
           *  These methods are used to recover the database after a crash,
           *  start_collect_garbage resets all non-zero refcounts to 1,
@@ -397,6 +454,219 @@ namespace triedent
                                       object_id                     origin2);
    };
 
+   // A cursor iterates over the keys of a tree in order. It keeps the path
+   // from the root to the current key, so next and prev only visit the nodes
+   // between two adjacent keys instead of searching from the root each time.
+   //
+   // The cursor holds a copy of the shared_ptr<root>. This prevents the tree
+   // from being edited in place; modifying the original shared_ptr<root>
+   // creates a new tree, which the cursor doesn't see. The path only stores
+   // object ids, which remain valid as long as the root is held, so the
+   // session lock is only held for the duration of each call. The session
+   // must outlive the cursor.
+   class cursor
+   {
+     public:
+      cursor(const read_session& session, std::shared_ptr<root> r);
+
+      // Returns false if the cursor is not at a key
+      bool valid() const { return !_path.empty(); }
+
+      // Each of these returns valid()
+      bool first();
+      bool last();
+      // Moves to the first key >= key
+      bool lower_bound(std::span<const char> key);
+      bool next();
+      // If the cursor is not at a key, moves to the last key
+      bool prev();
+
+      // These must only be called when the cursor is valid
+      void key(std::vector<char>& result) const;
+      bool value(std::vector<char>*                  result_bytes,
+                 std::vector<std::shared_ptr<root>>* result_roots) const;
+
+     private:
+      struct frame
+      {
+         object_id id;
+         // The branch that the path continues through. -1 if the cursor
+         // is at the inner node's value or if the node is a value node.
+         std::int8_t branch;
+         // The size of _key6 before this node's key
+         std::uint32_t key_pos;
+      };
+
+      void descend_first(session_lock_ref<> l, object_id id);
+      void descend_last(session_lock_ref<> l, object_id id);
+      bool step_forward(session_lock_ref<> l);
+      bool step_back(session_lock_ref<> l);
+
+      const read_session*   _session;
+      std::shared_ptr<root> _root;
+      std::vector<frame>    _path;
+      key_type              _key6;
+   };
+
+   // A subtree_cache computes a value for each subtree of a tree and keeps
+   // them, so that computing the value for a later version of the tree only
+   // visits the nodes that were added since the last call.
+   //
+   // The values of inner nodes are stored by the key6 of the branch that
+   // leads to the node, along with the node's id. Leaves usually make up
+   // most of a tree and are cheap to recompute, so they are not stored. The
+   // cache holds a copy of the last root that it was used with. As with
+   // cursor, this keeps the nodes from being freed or edited in place, so a
+   // node at the same position with the same id is the same subtree. Values
+   // for nodes that are not in the new tree are removed when their parent
+   // is visited.
+   template <typename T>
+   class subtree_cache
+   {
+     public:
+      struct child
+      {
+         std::uint8_t branch;
+         const T*     value;
+      };
+
+      struct node_info
+      {
+         // The key6 of the node. The first prefix_size chars are the
+         // branch that leads to the node and the rest are the node's key.
+         std::string_view key;
+         std::size_t      prefix_size;
+         // Subtrees stored as values are not supported
+         std::optional<std::string_view> value;
+         // In branch order
+         std::span<const child> children;
+      };
+
+      // Returns the value for the root of r or nullopt if r is empty.
+      // combine(const node_info&) -> T is called for each node that
+      // is not in the cache, after it is called for the node's children.
+      template <typename F>
+      std::optional<T> get(const read_session& session, const std::shared_ptr<root>& r, F&& combine);
+
+      void        clear();
+      std::size_t size() const { return _entries.size(); }
+
+     private:
+      struct entry
+      {
+         object_id id;
+         T         value;
+      };
+
+      // Returns the cached value or stores the value of a leaf in tmp
+      template <typename F>
+      const T& visit(const read_session& session,
+                     key_type&           key,
+                     object_id           id,
+                     F&                  combine,
+                     std::optional<T>&   tmp);
+
+      std::shared_ptr<root>     _root;
+      std::map<key_type, entry> _entries;
+   };
+
+   // A diff_iterator visits the keys whose values are different in two
+   // trees, in key order. The trees are walked together and a subtree
+   // that is the same node in both is skipped without reading it, so
+   // the cost depends on the number of nodes that are not shared rather
+   // than on the size of the trees. Like cursor, it holds both roots,
+   // and the session must outlive it.
+   class diff_iterator
+   {
+     public:
+      enum class change : std::uint8_t
+      {
+         // The key is only in r2
+         inserted,
+         // The key is only in r1
+         removed,
+         // The key has different values in r1 and r2
+         changed,
+      };
+
+      // If upper is empty it is considered greater than any key
+      diff_iterator(const read_session&   session,
+                    std::shared_ptr<root> r1,
+                    std::shared_ptr<root> r2,
+                    std::span<const char> lower,
+                    std::span<const char> upper);
+
+      // Returns false if the iterator is not at a key
+      bool valid() const { return !_path.empty(); }
+
+      // Each of these returns valid()
+      bool first();
+      bool next();
+
+      // These must only be called when the iterator is valid
+      change kind() const { return _kind; }
+      void   key(std::vector<char>& result) const;
+      // Returns false if the key is not in the tree
+      bool value1(std::vector<char>*                  result_bytes,
+                  std::vector<std::shared_ptr<root>>* result_roots) const;
+      bool value2(std::vector<char>*                  result_bytes,
+                  std::vector<std::shared_ptr<root>>* result_roots) const;
+
+     private:
+      // A position in a tree. If offset is less than the size of the
+      // node's key, the position is inside the key. id is 0 if the
+      // tree has nothing at this position.
+      struct position
+      {
+         object_id     id;
+         std::uint32_t offset;
+         friend bool   operator==(const position&, const position&) = default;
+      };
+
+      // The contents of a tree at a position
+      struct view
+      {
+         object_id         value;
+         std::string_view  rest;
+         const inner_node* inner;
+         position          pos;
+
+         std::uint8_t lower_bound(std::uint8_t b) const;
+         position     child(std::uint8_t b) const;
+      };
+
+      struct frame
+      {
+         position a;
+         position b;
+         // The last branch that was visited. -2 if the values have not
+         // been compared and -1 if no branch has been visited.
+         std::int8_t branch;
+         // The size of _key6 at this position
+         std::uint32_t key_pos;
+      };
+
+      view get_view(session_lock_ref<> l, position pos) const;
+      bool equal_values(session_lock_ref<> l, object_id v1, object_id v2) const;
+      void push(session_lock_ref<> l, position a, position b);
+      bool step(session_lock_ref<> l);
+      bool value(session_lock_ref<>                  l,
+                 const std::shared_ptr<root>&        r,
+                 object_id                           id,
+                 std::vector<char>*                  result_bytes,
+                 std::vector<std::shared_ptr<root>>* result_roots) const;
+
+      const read_session*   _session;
+      std::shared_ptr<root> _root1;
+      std::shared_ptr<root> _root2;
+      key_type              _lower6;
+      key_type              _upper6;
+      bool                  _has_upper;
+      std::vector<frame>    _path;
+      key_type              _key6;
+      change                _kind = change::changed;
+   };
+
    class database : public std::enable_shared_from_this<database>
    {
       template <typename AccessMode>
@@ -1144,6 +1414,23 @@ namespace triedent
                            result_roots);
    }
 
+   template <typename AccessMode>
+   template <typename F>
+   bool session<AccessMode>::get_value(const std::shared_ptr<root>& r,
+                                       std::span<const char>        key,
+                                       F&&                          f) const
+   {
+      swap_guard g(*this);
+      return unguarded_find(g, get_id(r), to_key6({key.data(), key.size()}),
+                            [&](const value_node& vn, node_type type)
+                            {
+                               if (type == node_type::roots)
+                                  throw std::runtime_error("get_value does not support subtrees");
+                               f(std::span<const char>{vn.data_ptr(), vn.data_size()});
+                               return true;
+                            });
+   }
+
    template <typename AccessMode>
    bool session<AccessMode>::unguarded_get(
        session_lock_ref<>                            l,
@@ -1152,6 +1439,19 @@ namespace triedent
        std::string_view                              key,
        std::vector<char>*                            result_bytes,
        std::vector<std::shared_ptr<triedent::root>>* result_roots) const
+   {
+      return unguarded_find(l, root, key,
+                            [&](const value_node& vn, node_type type)
+                            { return fill_result(ancestor, vn, type, result_bytes, result_roots); });
+   }
+
+   // Calls f(value_node, type) on the value with the given key
+   template <typename AccessMode>
+   template <typename F>
+   bool session<AccessMode>::unguarded_find(session_lock_ref<> l,
+                                            object_id          root,
+                                            std::string_view   key,
+                                            F&&                f) const
    {
       if (not root)
          return false;
@@ -1163,7 +1463,7 @@ namespace triedent
          {
             auto& vn = n.as_value_node();
             if (vn.key() == key)
-               return fill_result(ancestor, vn, n.type(), result_bytes, result_roots);
+               return f(vn, n.type());
             return false;
          }
          auto& in     = n.as_inner_node();
@@ -1477,6 +1777,566 @@ namespace triedent
       }
    }  // unguarded_get_max
 
+   template <typename AccessMode>
+   std::vector<key_prefix> session<AccessMode>::split(const std::shared_ptr<root>& r,
+                                                      std::size_t                  min_count) const
+   {
+      swap_guard g(*this);
+      // Each node is paired with the key6 of the branch that leads to it
+      std::vector<std::pair<object_id, key_type>> level, next;
+      if (auto id = get_id(r))
+         level.push_back({id, {}});
+      bool expanded = true;
+      while (expanded && level.size() < min_count)
+      {
+         expanded = false;
+         next.clear();
+         for (auto& [id, key6] : level)
+         {
+            auto n = get_by_id(g, id);
+            if (!n.is_leaf_node() && n.as_inner_node().num_branches() != 0)
+            {
+               auto& in   = n.as_inner_node();
+               auto  full = key6 + key_type(in.key());
+               for (auto b = in.lower_bound(0); b < 64; b = in.lower_bound(b + 1))
+                  next.push_back({in.branch(b), full + char(b)});
+               expanded = true;
+            }
+            else
+               next.push_back({id, std::move(key6)});
+         }
+         std::swap(level, next);
+      }
+
+      std::vector<key_prefix> result;
+      result.reserve(level.size());
+      for (auto& [id, key6] : level)
+      {
+         auto bits = key6.size() * 6;
+         // from_key6 drops a partial byte at the end
+         if (bits % 8)
+            key6.push_back(0);
+         auto bytes = from_key6(key6);
+         result.push_back({{bytes.begin(), bytes.end()}, bits});
+      }
+      return result;
+   }
+
+   inline cursor::cursor(const read_session& session, std::shared_ptr<root> r)
+       : _session(&session), _root(std::move(r))
+   {
+   }
+
+   inline bool cursor::first()
+   {
+      read_session::swap_guard l(*_session);
+      _path.clear();
+      _key6.clear();
+      if (auto id = _session->get_id(_root))
+         descend_first(l, id);
+      return valid();
+   }
+
+   inline bool cursor::last()
+   {
+      read_session::swap_guard l(*_session);
+      _path.clear();
+      _key6.clear();
+      if (auto id = _session->get_id(_root))
+         descend_last(l, id);
+      return valid();
+   }
+
+   inline bool cursor::lower_bound(std::span<const char> key)
+   {
+      read_session::swap_guard l(*_session);
+      _path.clear();
+      _key6.clear();
+      auto id = _session->get_id(_root);
+      if (!id)
+         return false;
+      key_type         key_buf;
+      std::string_view k = to_key6(key_buf, {key.data(), key.size()});
+      while (true)
+      {
+         auto n        = _session->get_by_id(l, id);
+         auto node_key = n.get_key();
+         auto pos      = static_cast<std::uint32_t>(_key6.size());
+         if (n.is_leaf_node())
+         {
+            if (node_key < k)
+               return step_forward(l);
+            _path.push_back({id, -1, pos});
+            _key6 += node_key;
+            return true;
+         }
+         auto& in   = n.as_inner_node();
+         auto  cpre = common_prefix(node_key, k);
+         if (cpre != node_key)
+         {
+            if (node_key < k)
+               return step_forward(l);
+            descend_first(l, id);
+            return true;
+         }
+         k = k.substr(cpre.size());
+         if (k.empty())
+         {
+            descend_first(l, id);
+            return true;
+         }
+         std::uint8_t start_b = k[0];
+         k                    = k.substr(1);
+         auto b               = in.lower_bound(start_b);
+         if (b >= 64)
+            return step_forward(l);
+         _path.push_back({id, static_cast<std::int8_t>(b), pos});
+         _key6 += node_key;
+         _key6.push_back(b);
+         if (b > start_b)
+         {
+            descend_first(l, in.branch(b));
+            return true;
+         }
+         id = in.branch(b);
+      }
+   }
+
+   inline bool cursor::next()
+   {
+      read_session::swap_guard l(*_session);
+      return step_forward(l);
+   }
+
+   inline bool cursor::prev()
+   {
+      if (!valid())
+         return last();
+      read_session::swap_guard l(*_session);
+      return step_back(l);
+   }
+
+   inline void cursor::key(std::vector<char>& result) const
+   {
+      auto s = from_key6(_key6);
+      result.assign(s.begin(), s.end());
+   }
+
+   inline bool cursor::value(std::vector<char>*                  result_bytes,
+                             std::vector<std::shared_ptr<root>>* result_roots) const
+   {
+      read_session::swap_guard l(*_session);
+      auto                     n = _session->get_by_id(l, _path.back().id);
+      if (!n.is_leaf_node())
+         n = _session->get_by_id(l, n.as_inner_node().value());
+      return _session->fill_result(_root, n.as_value_node(), n.type(), result_bytes,
+                                   result_roots);
+   }
+
+   // Extends the path to the smallest key in the subtree
+   inline void cursor::descend_first(session_lock_ref<> l, object_id id)
+   {
+      while (true)
+      {
+         auto n = _session->get_by_id(l, id);
+         _path.push_back({id, -1, static_cast<std::uint32_t>(_key6.size())});
+         _key6 += n.get_key();
+         if (n.is_leaf_node())
+            return;
+         auto& in = n.as_inner_node();
+         if (in.value())
+            return;
+         auto b              = in.lower_bound(0);
+         _path.back().branch = b;
+         _key6.push_back(b);
+         id = in.branch(b);
+      }
+   }
+
+   // Extends the path to the largest key in the subtree
+   inline void cursor::descend_last(session_lock_ref<> l, object_id id)
+   {
+      while (true)
+      {
+         auto n = _session->get_by_id(l, id);
+         _path.push_back({id, -1, static_cast<std::uint32_t>(_key6.size())});
+         _key6 += n.get_key();
+         if (n.is_leaf_node())
+            return;
+         auto& in = n.as_inner_node();
+         auto  b  = in.reverse_lower_bound(63);
+         if (b < 0)
+            return;
+         _path.back().branch = b;
+         _key6.push_back(b);
+         id = in.branch(b);
+      }
+   }
+
+   // Moves to the first key after the end of the path. The last frame
+   // may be the current key or an inner node whose current branch has
+   // already been visited.
+   inline bool cursor::step_forward(session_lock_ref<> l)
+   {
+      while (!_path.empty())
+      {
+         auto& f = _path.back();
+         auto  n = _session->get_by_id(l, f.id);
+         if (!n.is_leaf_node())
+         {
+            auto& in = n.as_inner_node();
+            auto  b  = in.lower_bound(f.branch + 1);
+            if (b < 64)
+            {
+               f.branch = b;
+               _key6.resize(f.key_pos + in.key().size());
+               _key6.push_back(b);
+               descend_first(l, in.branch(b));
+               return true;
+            }
+         }
+         _path.pop_back();
+      }
+      _key6.clear();
+      return false;
+   }
+
+   // Moves to the last key before the end of the path
+   inline bool cursor::step_back(session_lock_ref<> l)
+   {
+      while (!_path.empty())
+      {
+         auto& f = _path.back();
+         auto  n = _session->get_by_id(l, f.id);
+         if (!n.is_leaf_node() && f.branch >= 0)
+         {
+            auto& in = n.as_inner_node();
+            auto  b  = f.branch > 0 ? in.reverse_lower_bound(f.branch - 1) : -1;
+            _key6.resize(f.key_pos + in.key().size());
+            if (b >= 0)
+            {
+               f.branch = b;
+               _key6.push_back(b);
+               descend_last(l, in.branch(b));
+               return true;
+            }
+            if (in.value())
+            {
+               f.branch = -1;
+               return true;
+            }
+         }
+         _path.pop_back();
+      }
+      _key6.clear();
+      return false;
+   }
+
+   template <typename T>
+   template <typename F>
+   std::optional<T> subtree_cache<T>::get(const read_session&          session,
+                                          const std::shared_ptr<root>& r,
+                                          F&&                          combine)
+   {
+      auto id = session.get_id(r);
+      if (!id)
+      {
+         clear();
+         return std::nullopt;
+      }
+      try
+      {
+         key_type         key;
+         std::optional<T> tmp;
+         std::optional<T> result{visit(session, key, id, combine, tmp)};
+         // The new values are only valid as long as their nodes are held
+         _root = r;
+         return result;
+      }
+      catch (...)
+      {
+         clear();
+         throw;
+      }
+   }
+
+   template <typename T>
+   void subtree_cache<T>::clear()
+   {
+      _entries.clear();
+      _root.reset();
+   }
+
+   template <typename T>
+   template <typename F>
+   const T& subtree_cache<T>::visit(const read_session& session,
+                                    key_type&           key,
+                                    object_id           id,
+                                    F&                  combine,
+                                    std::optional<T>&   tmp)
+   {
+      auto pos = _entries.find(key);
+      if (pos != _entries.end() && pos->second.id == id)
+         return pos->second.value;
+
+      auto                                            prefix_size = key.size();
+      std::optional<value_type>                       value;
+      std::vector<std::pair<std::uint8_t, object_id>> branches;
+      std::uint64_t                                   present = 0;
+      {
+         read_session::swap_guard l(session);
+         auto                     n = session.get_by_id(l, id);
+         key += n.get_key();
+         if (auto v = n.value())
+         {
+            auto vn = v == id ? n : session.get_by_id(l, v);
+            if (vn.type() != node_type::bytes)
+               throw std::runtime_error("subtree_cache does not support subtrees");
+            value.emplace(vn.as_value_node().data());
+         }
+         if (!n.is_leaf_node())
+         {
+            auto& in = n.as_inner_node();
+            for (auto b = in.lower_bound(0); b < 64; b = in.lower_bound(b + 1))
+            {
+               branches.push_back({b, in.branch(b)});
+               present |= std::uint64_t(1) << b;
+            }
+         }
+      }
+
+      auto                          node_size = key.size();
+      std::vector<child>            children;
+      std::vector<std::optional<T>> leaves(branches.size());
+      children.reserve(branches.size());
+      for (std::size_t i = 0; i < branches.size(); ++i)
+      {
+         key.resize(node_size);
+         key.push_back(branches[i].first);
+         children.push_back(
+             {branches[i].first, &visit(session, key, branches[i].second, combine, leaves[i])});
+      }
+      key.resize(node_size);
+
+      // Remove the nodes below this position that are not below one of the
+      // children. The children's positions were handled by visit. A leaf
+      // also removes the entry for the node that it replaced.
+      key_type prefix = key.substr(0, prefix_size);
+      for (auto it = branches.empty() ? _entries.lower_bound(prefix)
+                                      : _entries.upper_bound(prefix);
+           it != _entries.end() && it->first.starts_with(prefix);)
+      {
+         if (it->first.size() > node_size && it->first.starts_with(key) &&
+             (present >> it->first[node_size]) & 1)
+            it = _entries.lower_bound(key + char(it->first[node_size] + 1));
+         else
+            it = _entries.erase(it);
+      }
+
+      T result = combine(node_info{
+          key, prefix_size,
+          value ? std::optional<std::string_view>{*value} : std::nullopt, children});
+      key.resize(prefix_size);
+      if (branches.empty())
+         return tmp.emplace(std::move(result));
+      return _entries.insert_or_assign(std::move(prefix), entry{id, std::move(result)})
+          .first->second.value;
+   }
+
+   template <typename AccessMode>
+   diff_iterator session<AccessMode>::diff(const std::shared_ptr<root>& r1,
+                                           const std::shared_ptr<root>& r2,
+                                           std::span<const char>        lower,
+                                           std::span<const char>        upper) const
+   {
+      return diff_iterator{*this, r1, r2, lower, upper};
+   }
+
+   inline diff_iterator::diff_iterator(const read_session&   session,
+                                       std::shared_ptr<root> r1,
+                                       std::shared_ptr<root> r2,
+                                       std::span<const char> lower,
+                                       std::span<const char> upper)
+       : _session(&session),
+         _root1(std::move(r1)),
+         _root2(std::move(r2)),
+         _has_upper(!upper.empty())
+   {
+      to_key6(_lower6, {lower.data(), lower.size()});
+      to_key6(_upper6, {upper.data(), upper.size()});
+   }
+
+   inline bool diff_iterator::first()
+   {
+      read_session::swap_guard l(*_session);
+      _path.clear();
+      _key6.clear();
+      position a{_session->get_id(_root1), 0};
+      position b{_session->get_id(_root2), 0};
+      if (a == b)
+         return false;
+      push(l, a, b);
+      return step(l);
+   }
+
+   inline bool diff_iterator::next()
+   {
+      read_session::swap_guard l(*_session);
+      return step(l);
+   }
+
+   inline void diff_iterator::key(std::vector<char>& result) const
+   {
+      auto s = from_key6(_key6);
+      result.assign(s.begin(), s.end());
+   }
+
+   inline bool diff_iterator::value1(std::vector<char>*                  result_bytes,
+                                     std::vector<std::shared_ptr<root>>* result_roots) const
+   {
+      read_session::swap_guard l(*_session);
+      return value(l, _root1, get_view(l, _path.back().a).value, result_bytes, result_roots);
+   }
+
+   inline bool diff_iterator::value2(std::vector<char>*                  result_bytes,
+                                     std::vector<std::shared_ptr<root>>* result_roots) const
+   {
+      read_session::swap_guard l(*_session);
+      return value(l, _root2, get_view(l, _path.back().b).value, result_bytes, result_roots);
+   }
+
+   inline std::uint8_t diff_iterator::view::lower_bound(std::uint8_t b) const
+   {
+      if (!rest.empty())
+         return static_cast<std::uint8_t>(rest[0]) >= b ? rest[0] : 64;
+      if (inner)
+         return inner->lower_bound(b);
+      return 64;
+   }
+
+   inline diff_iterator::position diff_iterator::view::child(std::uint8_t b) const
+   {
+      if (!rest.empty())
+         return rest[0] == b ? position{pos.id, pos.offset + 1} : position{};
+      if (inner && inner->has_branch(b))
+         return {inner->branch(b), 0};
+      return {};
+   }
+
+   inline diff_iterator::view diff_iterator::get_view(session_lock_ref<> l, position pos) const
+   {
+      view result{{}, {}, nullptr, pos};
+      if (!pos.id)
+         return result;
+      auto n   = _session->get_by_id(l, pos.id);
+      auto key = n.get_key();
+      if (pos.offset < key.size())
+         result.rest = key.substr(pos.offset);
+      else
+      {
+         result.value = n.value();
+         if (!n.is_leaf_node())
+            result.inner = &n.as_inner_node();
+      }
+      return result;
+   }
+
+   // Values that are not shared may still be equal, for example when a
+   // leaf was copied to change its key.
+   inline bool diff_iterator::equal_values(session_lock_ref<> l,
+                                           object_id          v1,
+                                           object_id          v2) const
+   {
+      if (v1 == v2)
+         return true;
+      if (!v1 || !v2)
+         return false;
+      auto n1 = _session->get_by_id(l, v1);
+      auto n2 = _session->get_by_id(l, v2);
+      return n1.type() == n2.type() && n1.as_value_node().data() == n2.as_value_node().data();
+   }
+
+   // Adds a frame for the subtrees at a and b. Inside a key, a tree has
+   // no value and only one branch, so the frame starts where the keys
+   // diverge or where one of them ends.
+   inline void diff_iterator::push(session_lock_ref<> l, position a, position b)
+   {
+      auto        va = get_view(l, a);
+      auto        vb = get_view(l, b);
+      std::size_t n  = !a.id   ? vb.rest.size()
+                       : !b.id ? va.rest.size()
+                               : common_prefix(va.rest, vb.rest).size();
+      _key6 += (a.id ? va.rest : vb.rest).substr(0, n);
+      if (a.id)
+         a.offset += n;
+      if (b.id)
+         b.offset += n;
+      _path.push_back({a, b, -2, static_cast<std::uint32_t>(_key6.size())});
+   }
+
+   // Moves to the next key with a difference
+   inline bool diff_iterator::step(session_lock_ref<> l)
+   {
+      while (!_path.empty())
+      {
+         auto& f = _path.back();
+         _key6.resize(f.key_pos);
+         auto va = get_view(l, f.a);
+         auto vb = get_view(l, f.b);
+         if (f.branch == -2)
+         {
+            // Every key after this one is also >= upper
+            if (_has_upper && _key6 >= _upper6)
+               break;
+            // Every key in this subtree is < lower
+            if (_key6 < _lower6 && !_lower6.starts_with(_key6))
+            {
+               _path.pop_back();
+               continue;
+            }
+            f.branch = -1;
+            if (_key6 >= _lower6 && !equal_values(l, va.value, vb.value))
+            {
+               _kind = !va.value   ? change::inserted
+                       : !vb.value ? change::removed
+                                   : change::changed;
+               return true;
+            }
+         }
+         auto next_branch = [&](std::uint8_t b)
+         { return std::min(va.lower_bound(b), vb.lower_bound(b)); };
+         auto b = next_branch(f.branch + 1);
+         // Subtrees that are the same node in both trees are skipped
+         while (b < 64 && va.child(b) == vb.child(b))
+            b = next_branch(b + 1);
+         if (b < 64)
+         {
+            f.branch = b;
+            _key6.push_back(b);
+            push(l, va.child(b), vb.child(b));
+         }
+         else
+         {
+            _path.pop_back();
+         }
+      }
+      _path.clear();
+      _key6.clear();
+      return false;
+   }
+
+   inline bool diff_iterator::value(session_lock_ref<>                  l,
+                                    const std::shared_ptr<root>&        r,
+                                    object_id                           id,
+                                    std::vector<char>*                  result_bytes,
+                                    std::vector<std::shared_ptr<root>>* result_roots) const
+   {
+      if (!id)
+         return false;
+      auto n = _session->get_by_id(l, id);
+      return _session->fill_result(r, n.as_value_node(), n.type(), result_bytes, result_roots);
+   }
+
    namespace detail
    {
 
@@ -2528,6 +3388,139 @@ namespace triedent
       update_root(l, r1, new_root);
    }
 
+   namespace detail
+   {
+      // Builds a tree bottom-up from keys in increasing order. The stack
+      // holds the nodes whose children are not known yet. Each of them is a
+      // prefix of the last key, ordered from shortest to longest. A node is
+      // written when a key arrives that doesn't extend it, because no later
+      // key can add to it either.
+      class bulk_builder
+      {
+        public:
+         bulk_builder(write_session& session, std::unique_lock<gc_session>& l)
+             : session(session), l(l)
+         {
+         }
+         // Releases the partial tree if the build doesn't finish
+         ~bulk_builder()
+         {
+            for (const auto& e : stack)
+               if (e.value)
+                  session.release(l, e.value);
+            for (auto child : children)
+               session.release(l, child);
+         }
+
+         void add(std::span<const char> key, std::span<const char> value)
+         {
+            auto k = to_key6(next_key, {key.data(), key.size()});
+            if (!stack.empty())
+            {
+               auto [k_pos, prev_pos] = std::ranges::mismatch(k, last_key);
+               auto common            = k_pos - k.begin();
+               if (k_pos == k.end() || (prev_pos != last_key.end() && *k_pos < *prev_pos))
+                  throw std::runtime_error("bulk_build: keys must be in increasing order");
+               if (prev_pos == last_key.end())
+                  // The last key is a prefix of this one, so its value
+                  // belongs to an inner node
+                  stack.back().value = value_node::make(session.ring(), l, {}, last_value,
+                                                        node_type::bytes, cold_cache)
+                                           .first.get_id();
+               else
+                  close(common);
+            }
+            last_key.swap(next_key);
+            last_value.assign(value.data(), value.size());
+            stack.push_back({static_cast<std::uint32_t>(k.size()), children.size()});
+         }
+
+         object_id finish()
+         {
+            if (stack.empty())
+               return {};
+            close(stack.front().depth);
+            auto result = make_node(0);
+            stack.clear();
+            return result;
+         }
+
+        private:
+         struct entry
+         {
+            // The length of the key6 prefix that leads to this node
+            std::uint32_t depth;
+            // The children of each entry follow the children of the entries
+            // below it, so they are stored together in one vector.
+            std::size_t   first_child;
+            object_id     value    = {};
+            std::uint64_t branches = 0;
+         };
+
+         // Writes the nodes that are deeper than depth, attaching each one
+         // to its parent. If two nodes diverge between the ends of two
+         // stack entries, a new node is started at the point of divergence.
+         void close(std::size_t depth)
+         {
+            while (stack.back().depth > depth)
+            {
+               if (stack.size() == 1 || stack[stack.size() - 2].depth < depth)
+                  stack.insert(stack.end() - 1,
+                               {static_cast<std::uint32_t>(depth), stack.back().first_child});
+               auto& parent = stack[stack.size() - 2];
+               auto  b      = static_cast<std::uint8_t>(last_key[parent.depth]);
+               auto  id     = make_node(parent.depth + 1);
+               stack.pop_back();
+               parent.branches |= inner_node::mask_eq(b);
+               children.push_back(id);
+            }
+         }
+
+         // Writes the node for the top of the stack, which takes ownership
+         // of its value and children. The first offset characters of its
+         // key belong to its ancestors.
+         object_id make_node(std::size_t offset)
+         {
+            auto& e   = stack.back();
+            auto  key = std::string_view{last_key}.substr(offset, e.depth - offset);
+            if (e.first_child == children.size())
+            {
+               // Only the node of the last key can be a leaf
+               assert(e.depth == last_key.size() && !e.value);
+               return value_node::make(session.ring(), l, key, last_value, node_type::bytes,
+                                       cold_cache)
+                   .first.get_id();
+            }
+            auto id = inner_node::make(session.ring(), l, key, e.value, e.branches,
+                                       children.data() + e.first_child, cold_cache)
+                          .first.get_id();
+            e.value = {};
+            children.resize(e.first_child);
+            return id;
+         }
+
+         write_session&                session;
+         std::unique_lock<gc_session>& l;
+         std::vector<entry>            stack;
+         std::vector<object_id>        children;
+         key_type                      last_key;
+         key_type                      next_key;
+         std::string                   last_value;
+      };
+   }  // namespace detail
+
+   std::shared_ptr<root> write_session::bulk_build(std::ranges::input_range auto&& rows)
+   {
+      std::unique_lock<gc_session> l(*this);
+      detail::bulk_builder         builder{*this, l};
+      for (const auto& [key, value] : rows)
+         builder.add(key, value);
+      std::shared_ptr<root> result;
+      if (auto id = builder.finish())
+         update_root(l, result, id);
+      return result;
+   }
+
    inline database::id write_session::remove_child(std::unique_lock<gc_session>& session,
                                                    id                            root,
                                                    bool                          unique,
@@ -69,11 +69,12 @@ namespace triedent
           std::unique_lock<gc_session>& session,
           key_view                      key,
           value_view                    val,
-          node_type                     type)
+          node_type                     type,
+          cache_level_type              level = hot_cache)
       {
          assert(val.size() < 0xffffff - key.size() - sizeof(value_node));
          uint32_t alloc_size = sizeof(value_node) + key.size() + val.size();
-         auto     r          = a.alloc(session, alloc_size, type);
+         auto     r          = a.alloc(session, alloc_size, type, level);
          if constexpr (debug_nodes)
             std::cout << r.first.get_id().id << ": construct value_node: type=" << (int)type
                       << std::endl;
@@ -236,7 +237,8 @@ namespace triedent
           key_builder auto              key,
           object_id                     value,
           uint64_t                      branches,
-          const object_id*              children);
+          const object_id*              children,
+          cache_level_type              level = hot_cache);
 
       inline bool has_branch(uint32_t b) const { return _present_bits & (1ull << b); }
 
@@ -333,12 +335,13 @@ namespace triedent
        key_builder auto              key,
        object_id                     value,
        uint64_t                      branches,
-       const object_id*              children)
+       const object_id*              children,
+       cache_level_type              level)
    {
       auto     n          = std::popcount(branches);
       uint32_t alloc_size = sizeof(inner_node) + key.size() + n * sizeof(object_id);
       // allocate a new node
-      auto p = a.alloc(session, alloc_size, node_type::inner);
+      auto p = a.alloc(session, alloc_size, node_type::inner, level);
       reload_key(a, session, key);
 
       auto newid = p.first.get_id();
@@ -0,0 +1,140 @@
+#include <triedent/database.hpp>
+
+#include "temp_database.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <map>
+#include <random>
+
+using namespace triedent;
+
+namespace
+{
+   using key_map = std::map<std::string, std::string>;
+
+   std::string random_key(std::mt19937& gen)
+   {
+      std::uniform_int_distribution<int> len(0, 6);
+      std::uniform_int_distribution<int> ch(0, 3);
+      std::string                        result(len(gen), 0);
+      for (auto& c : result)
+         c = static_cast<char>(ch(gen) * 0x55);
+      return result;
+   }
+
+   key_map contents(const read_session& session, const std::shared_ptr<root>& r)
+   {
+      key_map           result;
+      cursor            c{session, r};
+      std::vector<char> key, value;
+      for (bool ok = c.first(); ok; ok = c.next())
+      {
+         c.key(key);
+         c.value(&value, nullptr);
+         result.try_emplace({key.begin(), key.end()}, value.begin(), value.end());
+      }
+      return result;
+   }
+}  // namespace
+
+TEST_CASE("bulk_build")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+
+   CHECK(!session->bulk_build(key_map{}));
+
+   std::mt19937 gen(GENERATE(range(0, 20)));
+   key_map      expected;
+   auto         upserted = std::shared_ptr<root>{};
+   for (int i = 0, n = GENERATE(1, 2, 10, 200); i < n; ++i)
+   {
+      auto key   = random_key(gen);
+      auto value = std::to_string(i);
+      expected.insert_or_assign(key, value);
+      session->upsert(upserted, key, value);
+   }
+
+   auto r = session->bulk_build(expected);
+   REQUIRE(r);
+   session->validate(r);
+   CHECK(contents(*session, r) == expected);
+   CHECK(!session->diff(r, upserted, {}, {}).first());
+   for (const auto& [key, value] : expected)
+      CHECK(session->get(r, key) == std::vector<char>(value.begin(), value.end()));
+
+   // The result can be modified like any other tree
+   for (int i = 0; i < 20; ++i)
+   {
+      auto key = random_key(gen);
+      if (gen() % 2)
+      {
+         session->upsert(r, key, "new");
+         session->upsert(upserted, key, "new");
+      }
+      else
+      {
+         session->remove(r, key);
+         session->remove(upserted, key);
+      }
+   }
+   session->validate(r);
+   CHECK(contents(*session, r) == contents(*session, upserted));
+}
+
+TEST_CASE("bulk_build splice")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+
+   std::mt19937 gen(GENERATE(range(0, 10)));
+   key_map      expected;
+   auto         r     = std::shared_ptr<root>{};
+   std::string  value = "old";
+   for (int i = 0; i < 100; ++i)
+   {
+      auto key = random_key(gen);
+      session->upsert(r, key, value);
+      expected.insert_or_assign(key, value);
+   }
+
+   // Replace a range with rows that were built separately
+   auto lower = random_key(gen);
+   auto upper = random_key(gen);
+   if (!upper.empty() && upper < lower)
+      std::swap(lower, upper);
+   auto in_range = [&](const std::string& key)
+   { return key >= lower && (upper.empty() || key < upper); };
+   key_map rows;
+   for (int i = 0; i < 50; ++i)
+   {
+      auto key = random_key(gen);
+      if (in_range(key))
+         rows.insert_or_assign(key, std::to_string(i));
+   }
+   std::erase_if(expected, [&](const auto& row) { return in_range(row.first); });
+   expected.insert(rows.begin(), rows.end());
+
+   session->splice(r, session->bulk_build(rows), lower, upper);
+   session->validate(r);
+   CHECK(contents(*session, r) == expected);
+}
+
+TEST_CASE("bulk_build order")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+
+   using rows = std::vector<std::pair<std::string, std::string>>;
+   CHECK_THROWS_AS(session->bulk_build(rows{{"b", "1"}, {"a", "2"}}), std::runtime_error);
+   CHECK_THROWS_AS(session->bulk_build(rows{{"a", "1"}, {"a", "2"}}), std::runtime_error);
+   CHECK_THROWS_AS(session->bulk_build(rows{{"ab", "1"}, {"a", "2"}}), std::runtime_error);
+   CHECK_THROWS_AS(session->bulk_build(rows{{"a", "1"}, {"ab", "2"}, {"b", ""}, {"a", "3"}}),
+                   std::runtime_error);
+   // The nodes that were written before the error were released
+   CHECK(db->is_empty());
+
+   auto r = session->bulk_build(rows{{"", "0"}, {"a", "1"}, {"ab", "2"}, {"b", "3"}});
+   CHECK(contents(*session, r) == key_map{{"", "0"}, {"a", "1"}, {"ab", "2"}, {"b", "3"}});
+}
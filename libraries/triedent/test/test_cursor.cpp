@@ -0,0 +1,131 @@
+#include <triedent/database.hpp>
+
+#include "temp_database.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <map>
+#include <random>
+
+using namespace triedent;
+
+namespace
+{
+   // std::string compares chars as unsigned, which matches the order of the keys
+   using key_map = std::map<std::string, std::string>;
+
+   std::string random_key(std::mt19937& gen)
+   {
+      // Short keys over a small alphabet, so that keys share prefixes
+      // and some keys are prefixes of others
+      std::uniform_int_distribution<int> len(0, 5);
+      std::uniform_int_distribution<int> ch(0, 3);
+      std::string                        result(len(gen), 0);
+      for (auto& c : result)
+         c = static_cast<char>(ch(gen) * 0x55);
+      return result;
+   }
+
+   void check_forward(cursor& c, const key_map& expected)
+   {
+      std::vector<char> key, value;
+      auto              pos = expected.begin();
+      for (bool ok = c.first(); ok; ok = c.next(), ++pos)
+      {
+         REQUIRE(pos != expected.end());
+         c.key(key);
+         CHECK(std::string(key.begin(), key.end()) == pos->first);
+         c.value(&value, nullptr);
+         CHECK(std::string(value.begin(), value.end()) == pos->second);
+      }
+      CHECK(pos == expected.end());
+      CHECK(!c.valid());
+   }
+
+   void check_backward(cursor& c, const key_map& expected)
+   {
+      std::vector<char> key;
+      auto              pos = expected.rbegin();
+      for (bool ok = c.last(); ok; ok = c.prev(), ++pos)
+      {
+         REQUIRE(pos != expected.rend());
+         c.key(key);
+         CHECK(std::string(key.begin(), key.end()) == pos->first);
+      }
+      CHECK(pos == expected.rend());
+   }
+}  // namespace
+
+TEST_CASE("cursor")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+   auto r       = std::shared_ptr<root>{};
+
+   SECTION("empty")
+   {
+      cursor c{*session, r};
+      CHECK(!c.first());
+      CHECK(!c.last());
+      CHECK(!c.lower_bound(std::vector<char>{}));
+      CHECK(!c.prev());
+      CHECK(!c.next());
+   }
+
+   SECTION("random")
+   {
+      std::mt19937 gen(GENERATE(range(0, 20)));
+      key_map      expected;
+      for (int i = 0; i < 100; ++i)
+      {
+         auto key   = random_key(gen);
+         auto value = std::to_string(i);
+         session->upsert(r, key, value);
+         expected[key] = value;
+      }
+
+      cursor c{*session, r};
+      check_forward(c, expected);
+      check_backward(c, expected);
+
+      std::vector<char> found, less_key;
+      for (int i = 0; i < 100; ++i)
+      {
+         auto key = random_key(gen);
+         auto pos = expected.lower_bound(key);
+         CHECK(c.lower_bound(key) == (pos != expected.end()));
+         if (pos != expected.end())
+         {
+            c.key(found);
+            CHECK(std::string(found.begin(), found.end()) == pos->first);
+         }
+         CHECK(session->get_greater_equal(r, key, &found, nullptr, nullptr) == c.valid());
+         // prev from lower_bound finds the last key less than the search key
+         bool less = session->get_less_than(r, key, &less_key, nullptr, nullptr);
+         CHECK(c.prev() == less);
+         if (less)
+         {
+            c.key(found);
+            CHECK(found == less_key);
+         }
+      }
+   }
+
+   SECTION("modified tree")
+   {
+      key_map expected;
+      for (int i = 0; i < 50; ++i)
+      {
+         std::string key = "k" + std::to_string(i);
+         session->upsert(r, key, key);
+         expected[key] = key;
+      }
+      cursor c{*session, r};
+      REQUIRE(c.first());
+      // The cursor continues to see the tree that it was created with
+      for (int i = 0; i < 50; i += 2)
+         session->remove(r, "k" + std::to_string(i));
+      session->upsert(r, std::string_view{"a"}, std::string_view{"a"});
+      check_forward(c, expected);
+   }
+}
@@ -0,0 +1,158 @@
+#include <triedent/database.hpp>
+
+#include "temp_database.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <map>
+#include <random>
+
+using namespace triedent;
+
+namespace
+{
+   using key_map = std::map<std::string, std::string>;
+
+   std::string random_key(std::mt19937& gen)
+   {
+      std::uniform_int_distribution<int> len(0, 5);
+      std::uniform_int_distribution<int> ch(0, 3);
+      std::string                        result(len(gen), 0);
+      for (auto& c : result)
+         c = static_cast<char>(ch(gen) * 0x55);
+      return result;
+   }
+
+   struct change
+   {
+      std::string                key;
+      diff_iterator::change      kind;
+      std::optional<std::string> value1;
+      std::optional<std::string> value2;
+      friend bool                operator==(const change&, const change&) = default;
+      friend std::ostream&       operator<<(std::ostream& os, const change& c)
+      {
+         return os << "{" << Catch::StringMaker<std::string>::convert(c.key) << ", "
+                   << static_cast<int>(c.kind) << "}";
+      }
+   };
+
+   std::vector<change> expected_diff(const key_map&     m1,
+                                     const key_map&     m2,
+                                     const std::string& lower,
+                                     const std::string& upper)
+   {
+      std::vector<change> result;
+      auto                in_range = [&](const std::string& key)
+      { return key >= lower && (upper.empty() || key < upper); };
+      for (const auto& [key, value] : m1)
+      {
+         auto pos = m2.find(key);
+         if (!in_range(key))
+            continue;
+         if (pos == m2.end())
+            result.push_back({key, diff_iterator::change::removed, value, std::nullopt});
+         else if (pos->second != value)
+            result.push_back({key, diff_iterator::change::changed, value, pos->second});
+      }
+      for (const auto& [key, value] : m2)
+      {
+         if (in_range(key) && !m1.contains(key))
+            result.push_back({key, diff_iterator::change::inserted, std::nullopt, value});
+      }
+      std::ranges::sort(result, {}, &change::key);
+      return result;
+   }
+
+   std::vector<change> actual_diff(diff_iterator&& d)
+   {
+      std::vector<change> result;
+      std::vector<char>   key, value;
+      for (bool ok = d.first(); ok; ok = d.next())
+      {
+         d.key(key);
+         change c{{key.begin(), key.end()}, d.kind(), std::nullopt, std::nullopt};
+         if (d.value1(&value, nullptr))
+            c.value1.emplace(value.begin(), value.end());
+         if (d.value2(&value, nullptr))
+            c.value2.emplace(value.begin(), value.end());
+         result.push_back(std::move(c));
+      }
+      CHECK(!d.valid());
+      return result;
+   }
+}  // namespace
+
+TEST_CASE("diff")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+
+   std::mt19937 gen(GENERATE(range(0, 20)));
+   key_map      m1;
+   auto         r1 = std::shared_ptr<root>{};
+   for (int i = 0; i < 100; ++i)
+   {
+      auto key   = random_key(gen);
+      auto value = std::to_string(i % 10);
+      session->upsert(r1, key, value);
+      m1[key] = value;
+   }
+
+   key_map m2 = m1;
+   auto    r2 = r1;
+   SECTION("same tree")
+   {
+      CHECK(actual_diff(session->diff(r1, r2, {}, {})).empty());
+   }
+   SECTION("modified")
+   {
+      for (int i = 0, n = gen() % 20; i < n; ++i)
+      {
+         auto key = random_key(gen);
+         if (gen() % 2)
+         {
+            // Some of these write the value that is already there
+            auto value = std::to_string(gen() % 10);
+            session->upsert(r2, key, value);
+            m2[key] = value;
+         }
+         else
+         {
+            session->remove(r2, key);
+            m2.erase(key);
+         }
+      }
+   }
+   SECTION("unrelated")
+   {
+      r2 = nullptr;
+      m2.clear();
+      for (int i = 0; i < 100; ++i)
+      {
+         auto key   = random_key(gen);
+         auto value = std::to_string(i % 10);
+         session->upsert(r2, key, value);
+         m2[key] = value;
+      }
+   }
+   SECTION("empty")
+   {
+      r2 = nullptr;
+      m2.clear();
+   }
+
+   CHECK(actual_diff(session->diff(r1, r2, {}, {})) == expected_diff(m1, m2, "", ""));
+   CHECK(actual_diff(session->diff(r2, r1, {}, {})) == expected_diff(m2, m1, "", ""));
+   for (int i = 0; i < 10; ++i)
+   {
+      auto lower = random_key(gen);
+      auto upper = random_key(gen);
+      if (!upper.empty() && upper < lower)
+         std::swap(lower, upper);
+      INFO("lower: " << Catch::StringMaker<std::string>::convert(lower));
+      INFO("upper: " << Catch::StringMaker<std::string>::convert(upper));
+      CHECK(actual_diff(session->diff(r1, r2, lower, upper)) ==
+            expected_diff(m1, m2, lower, upper));
+   }
+}
@@ -0,0 +1,84 @@
+#include <triedent/database.hpp>
+
+#include "temp_database.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <random>
+
+using namespace triedent;
+
+namespace
+{
+   bool get_bit(std::span<const char> key, std::size_t n)
+   {
+      return (static_cast<unsigned char>(key[n / 8]) >> (7 - n % 8)) & 1;
+   }
+
+   // Returns true if the first bits of key match prefix
+   bool starts_with(std::span<const char> key, const key_prefix& prefix, std::size_t bits)
+   {
+      for (std::size_t i = 0; i < bits; ++i)
+         if (get_bit(key, i) != get_bit(prefix.prefix, i))
+            return false;
+      return true;
+   }
+}  // namespace
+
+TEST_CASE("split")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+   auto r       = std::shared_ptr<root>{};
+
+   CHECK(session->split(r, 4).empty());
+
+   std::mt19937                       gen(GENERATE(range(0, 10)));
+   std::uniform_int_distribution<int> len(0, 6);
+   std::uniform_int_distribution<int> ch(0, 255);
+   std::vector<std::string>           keys;
+   for (int i = 0; i < 500; ++i)
+   {
+      std::string key(len(gen), 0);
+      for (auto& c : key)
+         c = static_cast<char>(ch(gen) & 0xC3);
+      session->upsert(r, key, key);
+      keys.push_back(key);
+   }
+
+   auto min_count = GENERATE(1, 2, 16, 100);
+   auto prefixes  = session->split(r, min_count);
+   REQUIRE(!prefixes.empty());
+
+   for (std::size_t i = 0; i < prefixes.size(); ++i)
+   {
+      const auto& p = prefixes[i];
+      CHECK(p.prefix.size() == (p.bits + 7) / 8);
+      if (i > 0)
+      {
+         // In order and neither is a prefix of the other
+         const auto& prev = prefixes[i - 1];
+         auto        n    = std::min(prev.bits, p.bits);
+         auto        pos  = 0u;
+         while (pos < n && get_bit(prev.prefix, pos) == get_bit(p.prefix, pos))
+            ++pos;
+         REQUIRE(pos < n);
+         CHECK(!get_bit(prev.prefix, pos));
+      }
+   }
+
+   for (const auto& key : keys)
+   {
+      std::span<const char> k{key.data(), key.size()};
+      int                   matches = 0;
+      bool                  prefix  = false;
+      for (const auto& p : prefixes)
+      {
+         if (key.size() * 8 >= p.bits && starts_with(k, p, p.bits))
+            ++matches;
+         else if (key.size() * 8 < p.bits && starts_with(k, p, key.size() * 8))
+            prefix = true;
+      }
+      CHECK((matches == 1 || (matches == 0 && prefix)));
+   }
+}
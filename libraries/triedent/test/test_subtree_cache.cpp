@@ -0,0 +1,103 @@
+#include <triedent/database.hpp>
+
+#include "temp_database.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <random>
+
+using namespace triedent;
+
+namespace
+{
+   std::string random_key(std::mt19937& gen)
+   {
+      std::uniform_int_distribution<int> len(0, 6);
+      std::uniform_int_distribution<int> ch(0, 3);
+      std::string                        result(len(gen), 0);
+      for (auto& c : result)
+         c = static_cast<char>(ch(gen) * 0x55);
+      return result;
+   }
+
+   // Concatenates the keys and values of a subtree in order
+   struct concat
+   {
+      int*        calls;
+      std::string operator()(const subtree_cache<std::string>::node_info& node) const
+      {
+         ++*calls;
+         std::string result;
+         if (node.value)
+            result += from_key6(node.key) + "=" + std::string(*node.value) + ";";
+         for (const auto& child : node.children)
+            result += *child.value;
+         return result;
+      }
+   };
+
+   std::string expected_concat(const read_session& session, const std::shared_ptr<root>& r)
+   {
+      std::string       result;
+      cursor            c{session, r};
+      std::vector<char> key, value;
+      for (bool ok = c.first(); ok; ok = c.next())
+      {
+         c.key(key);
+         c.value(&value, nullptr);
+         result += std::string(key.begin(), key.end()) + "=" +
+                   std::string(value.begin(), value.end()) + ";";
+      }
+      return result;
+   }
+}  // namespace
+
+TEST_CASE("subtree_cache")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+   auto r       = std::shared_ptr<root>{};
+
+   subtree_cache<std::string> cache;
+   int                        calls = 0;
+   CHECK(!cache.get(*session, r, concat{&calls}));
+   CHECK(calls == 0);
+
+   std::mt19937 gen(GENERATE(range(0, 10)));
+   for (int i = 0; i < 200; ++i)
+      session->upsert(r, random_key(gen), std::to_string(i));
+
+   auto full = cache.get(*session, r, concat{&calls});
+   REQUIRE(full);
+   CHECK(*full == expected_concat(*session, r));
+   CHECK(cache.get(*session, r, concat{&calls}) == full);
+
+   for (int round = 0; round < 20; ++round)
+   {
+      // Keep the previous tree, like a revision would
+      auto prev = r;
+      for (int i = 0; i < 3; ++i)
+      {
+         if (gen() % 2)
+            session->upsert(r, random_key(gen), "r" + std::to_string(round));
+         else
+            session->remove(r, random_key(gen));
+      }
+
+      calls       = 0;
+      auto result = cache.get(*session, r, concat{&calls});
+      INFO("round " << round);
+      CHECK(result.value_or("") == expected_concat(*session, r));
+
+      // A new cache visits every node, but only the paths to
+      // the changed keys need to be visited again
+      subtree_cache<std::string> fresh;
+      int                        fresh_calls = 0;
+      CHECK(fresh.get(*session, r, concat{&fresh_calls}) == result);
+      CHECK(calls < fresh_calls / 2);
+      // Nodes that were removed from the tree were also removed from the cache
+      CHECK(cache.size() == fresh.size());
+      // Leaves are not stored
+      CHECK(fresh.size() < static_cast<std::size_t>(fresh_calls));
+   }
+}
@@ -161,6 +161,36 @@ TEST_CASE("erase")
    }
 }
 
+TEST_CASE("get_value")
+{
+   auto db      = createDb();
+   auto session = db->start_write_session();
+   auto root    = session->get_top_root();
+   auto sub     = session->get_top_root();
+   session->upsert(root, "abc"s, "v0"s);
+   session->upsert(root, "abcd"s, "v1"s);
+   session->upsert(sub, "x"s, "y"s);
+   session->upsert(root, "abce"s, std::span{&sub, 1});
+
+   auto get = [&](std::string_view key)
+   {
+      std::optional<std::string> result;
+      if (session->get_value(root, key,
+                             [&](std::span<const char> value) {
+                                result.emplace(value.begin(), value.end());
+                             }))
+      {
+         CHECK(result);
+      }
+      return result;
+   };
+   CHECK(get("abc") == "v0");
+   CHECK(get("abcd") == "v1");
+   CHECK(get("ab") == std::nullopt);
+   CHECK(get("abcf") == std::nullopt);
+   CHECK_THROWS(get("abce"));
+}
+
 TEST_CASE("recover")
 {
    temp_directory dir("triedent-test");
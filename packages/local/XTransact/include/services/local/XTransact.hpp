@@ -7,7 +7,8 @@ namespace LocalService
    enum class TransactionCallbackType : std::uint32_t
    {
       nextTransaction,
-      preverifyTransaction
+      preverifyTransaction,
+      nextTransactions,
    };
 
    struct XTransact : psibase::Service
@@ -25,6 +25,8 @@ namespace
             return NotifyType::nextTransaction;
          case TransactionCallbackType::preverifyTransaction:
             return NotifyType::preverifyTransaction;
+         case TransactionCallbackType::nextTransactions:
+            return NotifyType::nextTransactions;
          default:
             abortMessage("Unknown callback type");
       }
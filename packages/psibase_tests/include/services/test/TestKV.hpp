@@ -10,6 +10,8 @@ namespace TestService
       static constexpr auto service = psibase::AccountNumber{"test-kv"};
       static constexpr auto flags   = psibase::CodeRow::isPrivileged;
       void                  test();
+      void                  scan();
+      void                  getInto();
    };
-   PSIO_REFLECT(TestKV, method(test))
+   PSIO_REFLECT(TestKV, method(test), method(scan), method(getInto))
 }  // namespace TestService
@@ -50,6 +50,8 @@ namespace TestService
       void removeSingle();
       void removeMulti();
       void subindex();
+      void prefetch();
+      void connection();
    };
    PSIO_REFLECT(TestTable,
                 method(getSingle),
@@ -57,6 +59,8 @@ namespace TestService
                 method(getCompound),
                 method(removeSingle),
                 method(removeMulti),
-                method(subindex))
+                method(subindex),
+                method(prefetch),
+                method(connection))
    PSIBASE_REFLECT_TABLES(TestTable, TestTable::Tables)
 }  // namespace TestService
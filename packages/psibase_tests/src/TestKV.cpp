@@ -5,6 +5,8 @@
 #include <psio/to_key.hpp>
 #include <services/test/TestKV.hpp>
 
+#include <cstring>
+
 using namespace psibase;
 using namespace TestService;
 
@@ -159,4 +161,123 @@ void TestKV::test()
 
 }  // test()
 
+using Rows = std::vector<std::pair<std::vector<char>, std::vector<char>>>;
+
+// Calls kvScan and unpacks the rows. Returns nullopt if there are no rows.
+static std::optional<Rows> scanRows(KvHandle                 handle,
+                                    const std::vector<char>& key,
+                                    uint32_t                 matchKeySize,
+                                    uint32_t                 maxRows,
+                                    uint32_t                 destSize = 1024)
+{
+   std::vector<char> buffer(destSize);
+   auto size = raw::kvScan(handle, key.data(), key.size(), matchKeySize, maxRows, buffer.data(),
+                           buffer.size());
+   if (size == -1)
+      return std::nullopt;
+   check(size <= buffer.size(), "row does not fit");
+   Rows        result;
+   const char* pos  = buffer.data();
+   auto        read = [&]
+   {
+      uint32_t len;
+      std::memcpy(&len, pos, 4);
+      pos += 4;
+      std::vector<char> data(pos, pos + len);
+      pos += len;
+      return data;
+   };
+   while (pos != buffer.data() + size)
+   {
+      auto key = read();
+      result.push_back({std::move(key), read()});
+   }
+   return result;
+}
+
+void TestKV::scan()
+{
+   auto handle = kvOpen(DbId::service, psio::convert_to_key(getReceiver()), KvMode::readWrite);
+
+   // These keys don't overlap the ones used by test()
+   Rows rows = {
+       {{0x30, 0x01}, {0x01}},
+       {{0x30, 0x02, 0x00}, {0x02}},
+       {{0x30, 0x02, 0x01}, {0x03}},
+       {{0x30, 0x03}, {0x04}},
+   };
+   for (const auto& [key, value] : rows)
+      kvPutRaw(handle, key, value);
+   kvPutRaw(handle, std::vector<char>{0x31}, std::vector<char>{0x05});
+   auto after = [](std::vector<char> key)
+   {
+      key.push_back(0);
+      return key;
+   };
+
+   // Empty range
+   check(!scanRows(handle, {0x40}, 1, 10), "scan past the end");
+   check(!scanRows(handle, {0x30, 0x04}, 1, 10), "scan past the end of the prefix");
+   check(!scanRows(handle, {0x30}, 1, 0), "scan with no rows");
+
+   // Exactly one page
+   check(scanRows(handle, {0x30}, 1, 4) == rows, "one page");
+   check(!scanRows(handle, after(rows.back().first), 1, 4), "after one page");
+
+   // The page ends in the middle of the prefix, and the next page continues from it
+   auto first = scanRows(handle, {0x30}, 1, 2);
+   check(first == Rows(rows.begin(), rows.begin() + 2), "first page");
+   auto second = scanRows(handle, after(first->back().first), 1, 2);
+   check(second == Rows(rows.begin() + 2, rows.end()), "second page");
+
+   // A longer match only returns rows with that prefix
+   check(scanRows(handle, {0x30, 0x02}, 2, 10) == Rows(rows.begin() + 1, rows.begin() + 3),
+         "scan a nested prefix");
+
+   // A row that doesn't fit ends the page early
+   check(scanRows(handle, {0x30}, 1, 10, 8 + 2 + 1) == Rows(rows.begin(), rows.begin() + 1),
+         "partial page");
+   std::vector<char> small(4);
+   std::vector<char> start{0x30};
+   check(raw::kvScan(handle, start.data(), start.size(), 1, 10, small.data(), small.size()) ==
+             8 + 2 + 1,
+         "the size of the first row is returned if it does not fit");
+}
+
+void TestKV::getInto()
+{
+   auto handle = kvOpen(DbId::service, psio::convert_to_key(getReceiver()), KvMode::readWrite);
+
+   std::vector<char> key{0x40};
+   std::vector<char> value(300);
+   for (std::size_t i = 0; i < value.size(); ++i)
+      value[i] = static_cast<char>(i);
+   kvPutRaw(handle, key, value);
+
+   // The value is copied into dest when it fits
+   std::vector<char> dest(value.size());
+   check(raw::kvGetInto(handle, key.data(), key.size(), dest.data(), dest.size()) == value.size(),
+         "size of a value that fits");
+   check(dest == value, "value that fits");
+
+   // Otherwise dest is untouched and the value is in the result
+   std::vector<char> small(4, 'x');
+   check(raw::kvGetInto(handle, key.data(), key.size(), small.data(), small.size()) ==
+             value.size(),
+         "size of a value that does not fit");
+   check(small == std::vector<char>(4, 'x'), "dest is not modified");
+   check(getResult(value.size()) == value, "result holds a value that does not fit");
+
+   std::vector<char> missing{0x41};
+   check(raw::kvGetInto(handle, missing.data(), missing.size(), dest.data(), dest.size()) == -1,
+         "missing key");
+   check(getResult().empty(), "result is cleared for a missing key");
+
+   // kvGetRaw reads values both smaller and larger than its initial buffer
+   kvPutRaw(handle, missing, std::vector<char>{0x01});
+   check(kvGetRaw(handle, key) == value, "kvGetRaw of a large value");
+   check(kvGetRaw(handle, missing) == std::vector<char>{0x01}, "kvGetRaw of a small value");
+   check(!kvGetRaw(handle, std::vector<char>{0x42}), "kvGetRaw of a missing key");
+}
+
 PSIBASE_DISPATCH(TestKV)
@@ -1,6 +1,7 @@
 #include <services/test/TestTable.hpp>
 
 #include <psibase/dispatch.hpp>
+#include <psibase/serveGraphQL.hpp>
 
 using namespace psibase;
 
@@ -109,6 +110,124 @@ namespace TestService
       check(result[1] == S2{3, 1, 4}, "iter val1");
    }
 
+   // Replaces the contents of SingleKeyTable with the rows 0-9
+   static std::vector<S0> resetSingle(SingleKeyTable& t0)
+   {
+      std::vector<int> keys;
+      for (auto row : t0.getIndex<0>())
+         keys.push_back(row.key);
+      for (auto key : keys)
+         t0.erase(key);
+      std::vector<S0> rows;
+      for (int i = 0; i < 10; ++i)
+      {
+         rows.push_back(S0{i, i * 10});
+         t0.put(rows.back());
+      }
+      return rows;
+   }
+
+   void TestTable::prefetch()
+   {
+      auto t0   = open<SingleKeyTable>();
+      auto idx0 = t0.getIndex<0>();
+      auto rows = resetSingle(t0);
+
+      auto it = idx0.lower_bound(10);
+      it.prefetch(4);
+      check(it == idx0.end(), "prefetch an empty range");
+
+      // A page that ends before, at, or after the last row
+      for (std::uint32_t n : {1, 3, 5, 10, 11})
+      {
+         std::vector<S0> result;
+         auto            iter = idx0.begin();
+         iter.prefetch(n);
+         for (; iter != idx0.end(); ++iter)
+            result.push_back(*iter);
+         check(result == rows, "prefetch " + std::to_string(n));
+      }
+
+      // Moving backward discards the page
+      it = idx0.begin();
+      it.prefetch(4);
+      ++it;
+      ++it;
+      check((*--it).key == 1, "decrement after prefetch");
+      check((*++it).key == 2, "increment after decrement");
+      it = idx0.end();
+      it.prefetch(4);
+      check((*--it).key == 9, "decrement from end");
+
+      // A copy keeps its rows when the original loads the next page
+      it = idx0.begin();
+      it.prefetch(2);
+      ++it;
+      auto copy = it;
+      ++it;
+      check(*copy == rows[1] && *it == rows[2], "copy of a prefetched iterator");
+
+      // A secondary index within a prefix. The page ends in the middle of the
+      // prefix and the next page must not go past it.
+      auto t2   = open<CompoundKeyTable>();
+      auto idx1 = t2.getIndex<1>();
+      t2.put(S2{10, 20, 1});
+      t2.put(S2{11, 20, 2});
+      t2.put(S2{12, 20, 3});
+      t2.put(S2{13, 21, 4});
+      auto            sub = idx1.subindex<int>(20);
+      std::vector<S2> result;
+      auto            it2 = sub.begin();
+      it2.prefetch(2);
+      for (; it2 != sub.end(); ++it2)
+         result.push_back(*it2);
+      check(result == std::vector<S2>{{10, 20, 1}, {11, 20, 2}, {12, 20, 3}},
+            "prefetch in a subindex");
+   }
+
+   void TestTable::connection()
+   {
+      using Conn = Connection<S0, "SingleKeyConnection", "SingleKeyEdge">;
+      auto t0    = open<SingleKeyTable>();
+      auto idx0  = t0.getIndex<0>();
+      auto rows  = resetSingle(t0);
+
+      std::optional<int>         none;
+      std::optional<std::string> noCursor;
+      auto                       nodes = [](const Conn& conn)
+      {
+         std::vector<S0> result;
+         for (const auto& edge : conn.edges)
+            result.push_back(edge.node);
+         return result;
+      };
+
+      auto all = makeConnection<Conn>(idx0, none, none, none, none, {}, {}, noCursor, noCursor);
+      check(nodes(all) == rows && !all.pageInfo.hasNextPage, "all rows");
+
+      auto page = makeConnection<Conn>(idx0, none, none, none, none, 3, {}, noCursor, noCursor);
+      check(nodes(page) == std::vector(rows.begin(), rows.begin() + 3), "first page");
+      check(page.pageInfo.hasNextPage, "first page has next");
+
+      page = makeConnection<Conn>(idx0, none, none, none, none, 7, {}, noCursor,
+                                  page.pageInfo.endCursor);
+      check(nodes(page) == std::vector(rows.begin() + 3, rows.end()), "exactly the last page");
+      check(!page.pageInfo.hasNextPage && page.pageInfo.hasPreviousPage, "last page");
+
+      page = makeConnection<Conn>(idx0, none, none, std::optional{5}, none, {}, {}, noCursor,
+                                  noCursor);
+      check(nodes(page) == std::vector(rows.begin(), rows.begin() + 5), "range");
+      check(!page.pageInfo.hasNextPage, "range end");
+
+      page = makeConnection<Conn>(idx0, none, none, none, none, {}, 2, noCursor, noCursor);
+      check(nodes(page) == std::vector(rows.end() - 2, rows.end()), "last");
+      check(page.pageInfo.hasPreviousPage, "last has previous");
+
+      page = makeConnection<Conn>(idx0, none, std::optional{10}, none, none, 5, {}, noCursor,
+                                  noCursor);
+      check(page.edges.empty() && !page.pageInfo.hasNextPage, "empty");
+   }
+
 }  // namespace TestService
 
 PSIBASE_DISPATCH(TestService::TestTable)
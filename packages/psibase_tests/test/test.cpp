@@ -33,6 +33,8 @@ TEST_CASE("kv")
 
    t.addService(TestKV::service, "TestKV.wasm", TestKV::flags);
    CHECK(t.from(TestKV::service).to<TestKV>().test().succeeded());
+   CHECK(t.from(TestKV::service).to<TestKV>().scan().succeeded());
+   CHECK(t.from(TestKV::service).to<TestKV>().getInto().succeeded());
 }  // kv
 
 TEST_CASE("table")
@@ -47,6 +49,8 @@ TEST_CASE("table")
    CHECK(testTable.removeSingle().succeeded());
    CHECK(testTable.removeMulti().succeeded());
    CHECK(testTable.subindex().succeeded());
+   CHECK(testTable.prefetch().succeeded());
+   CHECK(testTable.connection().succeeded());
 }  // table
 
 TEST_CASE("import/export handles")
@@ -101,3 +101,27 @@ TEST_CASE("Test KvMerkle large")
    { return KvMerkle::combine(as_node(items, lhs), as_node(items, rhs)); };
    CHECK(std::move(merkle).root() == n(0, n(n(1, 2), n(3, 4))));
 }
+
+TEST_CASE("Test KvMerkle subtree")
+{
+   std::vector<KvMerkle::Item> items;
+   items.emplace_back(""_x, ""_x);
+   items.emplace_back("C0"_x, ""_x);
+   items.emplace_back("C8"_x, ""_x);
+   items.emplace_back("FC"_x, ""_x);
+   items.emplace_back("FC00"_x, ""_x);
+   auto n = [&](auto lhs, auto rhs)
+   { return KvMerkle::combine(as_node(items, lhs), as_node(items, rhs)); };
+
+   // A subset of keys with a common prefix hashes to the node for the prefix
+   KvMerkle part;
+   part.push(items[1]);
+   part.push(items[2]);
+   CHECK(std::move(part).root() == n(1, 2));
+
+   KvMerkle merkle;
+   merkle.push(items[0]);
+   merkle.push_subtree(std::vector<unsigned char>{0xC0}, 4, n(1, 2));
+   merkle.push_subtree(std::vector<unsigned char>{0xF0}, 4, n(3, 4));
+   CHECK(std::move(merkle).root() == n(0, n(n(1, 2), n(3, 4))));
+}
@@ -106,6 +106,7 @@ namespace SystemService
                                                      "Content-Security-Policy",
                                                      "ETag",
                                                      "Location",
+                                                     "Psibase-Cache",
                                                      "Set-Cookie",
                                                      "X-Content-Type-Options"};
 
@@ -273,7 +273,10 @@ namespace SystemService
                                                                VerifyIdTable,
                                                                BlockSizeTable>;
 
+      // nextBatch returns up to maxCount transactions. The producer
+      // applies all of them before asking for more.
       std::optional<psibase::SignedTransaction>                    next();
+      std::vector<psibase::SignedTransaction>                      nextBatch(std::uint32_t maxCount);
       std::optional<std::vector<std::optional<psibase::RunToken>>> preverify(
           psio::view<const psibase::SignedTransaction> trx);
       // Handles transactions coming over P2P
@@ -301,6 +304,7 @@ namespace SystemService
    };
    PSIO_REFLECT(RTransact,
                 method(next),
+                method(nextBatch, maxCount),
                 method(preverify, transaction),
                 method(recv, transaction),
                 method(onTrx, id, trace),
@@ -67,70 +67,103 @@ namespace
       auto config = table.get({});
       return config && config->enabled;
    }
-}  // namespace
 
-std::optional<SignedTransaction> SystemService::RTransact::next()
-{
-   check(getSender() == AccountNumber{}, "Wrong sender");
-   if (isResMonitoring())
+   // Soft limit for boot blocks (hard limit imposed by triedent
+   // is 16 MiB for the packed block)
+   constexpr std::uint32_t blockLimit = 8 * 1024 * 1024;
+
+   // Returns up to maxCount pending transactions in sequence order
+   std::vector<SignedTransaction> takeTransactions(std::uint32_t maxCount)
    {
-      if (!to<VirtualServer>().can_push_tx())
+      std::uint32_t blockSize = 0;
+      if (isResMonitoring())
       {
-         return {};
+         if (!to<VirtualServer>().can_push_tx())
+         {
+            return {};
+         }
+         // Whether there is room for another transaction depends on
+         // the resources consumed by the previous one.
+         maxCount = std::min(maxCount, std::uint32_t{1});
       }
-   }
-   else
-   {
-      // Soft limit for boot blocks (hard limit imposed by triedent
-      // is 16 MiB for the packed block)
-      constexpr std::uint32_t blockLimit = 8 * 1024 * 1024;
-      if (auto sizeRow = open<BlockSizeTable>().get({}))
+      else
       {
-         if (sizeRow->currentBlockSize >= blockLimit)
+         if (auto sizeRow = RTransact{}.open<BlockSizeTable>().get({}))
          {
-            return {};
+            blockSize = sizeRow->currentBlockSize;
+            if (blockSize >= blockLimit)
+            {
+               return {};
+            }
          }
       }
-   }
-   auto unapplied    = WriteOnly{}.open<UnappliedTransactionTable>();
-   auto reverify     = open<ReverifySignaturesTable>();
-   auto nextSequence = unapplied.get({}).value_or(UnappliedTransactionRecord{0}).nextSequence;
-   auto included     = Transact::Tables{Transact::service}.open<IncludedTrxTable>();
-   std::optional<SignedTransaction> result;
+      auto unapplied     = RTransact::WriteOnly{}.open<UnappliedTransactionTable>();
+      auto reverify      = RTransact{}.open<ReverifySignaturesTable>();
+      auto startSequence = unapplied.get({}).value_or(UnappliedTransactionRecord{0}).nextSequence;
+      auto included      = Transact::Tables{Transact::service}.open<IncludedTrxTable>();
+      auto startSize     = blockSize;
+      std::vector<SignedTransaction> result;
 
-   auto verifyId = open<VerifyIdTable>().get({}).value_or(VerifyIdRecord{}).verifyId;
+      auto verifyId = RTransact{}.open<VerifyIdTable>().get({}).value_or(VerifyIdRecord{}).verifyId;
 
-   PSIBASE_SUBJECTIVE_TX
-   {
-      auto invalidated = reverify.get({}).value_or(ReverifySignaturesRecord{});
-      if (invalidated.verifyId != verifyId)
+      PSIBASE_SUBJECTIVE_TX
       {
-         flushTransactions(reverify, invalidated, verifyId);
-      }
-      nextSequence = std::max(nextSequence, invalidated.endSequence);
-      auto table   = Subjective{}.open<PendingTransactionTable>();
-      auto index   = table.getIndex<1>();
-      for (auto iter = index.lower_bound(nextSequence), end = index.end(); iter != end; ++iter)
-      {
-         auto item    = *iter;
-         nextSequence = item.sequence + 1;
-         if (!included.get(std::tuple(item.expiration, item.id)))
+         // Everything that the loop advances must be reset when the
+         // transaction is retried. unapplied is not subjective, so the
+         // value written by a failed attempt is not rolled back.
+         result.clear();
+         blockSize         = startSize;
+         auto nextSequence = startSequence;
+         auto invalidated  = reverify.get({}).value_or(ReverifySignaturesRecord{});
+         if (invalidated.verifyId != verifyId)
          {
-            auto trxData = Subjective{}.open<TransactionDataTable>();
-            auto data    = trxData.get(item.id);
-            check(!!data, "Internal error: missing transaction data");
-            result = std::move(data->trx);
-            break;
+            flushTransactions(reverify, invalidated, verifyId);
+         }
+         nextSequence = std::max(nextSequence, invalidated.endSequence);
+         auto table   = RTransact::Subjective{}.open<PendingTransactionTable>();
+         auto index   = table.getIndex<1>();
+         auto trxData = RTransact::Subjective{}.open<TransactionDataTable>();
+         for (auto iter = index.lower_bound(nextSequence), end = index.end();
+              iter != end && result.size() < maxCount && blockSize < blockLimit; ++iter)
+         {
+            auto item    = *iter;
+            nextSequence = item.sequence + 1;
+            if (!included.get(std::tuple(item.expiration, item.id)))
+            {
+               auto data = trxData.get(item.id);
+               check(!!data, "Internal error: missing transaction data");
+               // The size is only an estimate of the block size until
+               // the transaction is applied.
+               blockSize += psio::fracpack_size(data->trx);
+               result.push_back(std::move(data->trx));
+            }
+         }
+         unapplied.put({nextSequence});
+         if (result.empty())
+         {
+            to<XTransact>().removeCallback(TransactionCallbackType::nextTransaction,
+                                           MethodNumber{"next"});
+            to<XTransact>().removeCallback(TransactionCallbackType::nextTransactions,
+                                           MethodNumber{"nextBatch"});
          }
       }
-      unapplied.put({nextSequence});
-      if (!result)
-      {
-         to<XTransact>().removeCallback(TransactionCallbackType::nextTransaction,
-                                        MethodNumber{"next"});
-      }
+      return result;
    }
-   return result;
+}  // namespace
+
+std::optional<SignedTransaction> SystemService::RTransact::next()
+{
+   check(getSender() == AccountNumber{}, "Wrong sender");
+   auto result = takeTransactions(1);
+   if (result.empty())
+      return {};
+   return std::move(result.front());
+}
+
+std::vector<SignedTransaction> SystemService::RTransact::nextBatch(std::uint32_t maxCount)
+{
+   check(getSender() == AccountNumber{}, "Wrong sender");
+   return takeTransactions(maxCount);
 }
 
 std::optional<std::vector<std::optional<RunToken>>> RTransact::preverify(
@@ -305,6 +338,8 @@ namespace
 
       // Tell native that we have a transaction
       to<XTransact>().addCallback(TransactionCallbackType::nextTransaction, MethodNumber{"next"});
+      to<XTransact>().addCallback(TransactionCallbackType::nextTransactions,
+                                  MethodNumber{"nextBatch"});
       to<XTransact>().addCallback(TransactionCallbackType::preverifyTransaction,
                                   MethodNumber{"preverify"});
    }
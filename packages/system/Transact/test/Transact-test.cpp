@@ -433,6 +433,78 @@ TEST_CASE("Test firstAuth")
    }
 }
 
+TEST_CASE("Test next transaction batch")
+{
+   DefaultTestChain t;
+   auto             alice = t.addAccount("alice");
+   t.startBlock();
+   t.setAutoRun(false);
+
+   std::vector<AsyncHttpReply> replies;
+   for (std::uint32_t i = 0; i < 3; ++i)
+   {
+      // Different expirations make the transactions distinct
+      auto trx = t.signTransaction(
+          t.makeTransaction({Action{.sender = alice, .service = AccountNumber{"nop"}}}, 5 + i));
+      replies.push_back(t.asyncPost(Transact::service, "/push_transaction?wait_for=applied",
+                                    FracPackBody{std::move(trx)}));
+   }
+   // Verify signatures
+   while (t.runQueueItem())
+   {
+   }
+
+   auto first = t.pushNextTransactions(2);
+   REQUIRE(first.size() == 2);
+   auto second = t.pushNextTransactions(2);
+   REQUIRE(second.size() == 1);
+   // Draining the queue removes both callbacks
+   CHECK(t.pushNextTransactions(2).empty());
+   CHECK(!t.kvGet<NotifyRow>(DbId::nativeSubjective, notifyKey(NotifyType::nextTransactions)));
+   CHECK(!t.kvGet<NotifyRow>(DbId::nativeSubjective, notifyKey(NotifyType::nextTransaction)));
+
+   for (const auto& trace : first)
+      CHECK(Result<void>(TransactionTrace{trace}).succeeded());
+   CHECK(Result<void>(TransactionTrace{second.front()}).succeeded());
+   t.runAll();
+   for (auto& reply : replies)
+      CHECK(Result<void>(reply.get<TransactionTrace>()).succeeded());
+}
+
+TEST_CASE("Test next transaction batch retry")
+{
+   DefaultTestChain t;
+   auto             alice = t.addAccount("alice");
+   t.startBlock();
+   t.setAutoRun(false);
+
+   std::vector<AsyncHttpReply> replies;
+   for (std::uint32_t i = 0; i < 3; ++i)
+   {
+      auto trx = t.signTransaction(
+          t.makeTransaction({Action{.sender = alice, .service = AccountNumber{"nop"}}}, 5 + i));
+      replies.push_back(t.asyncPost(Transact::service, "/push_transaction?wait_for=applied",
+                                    FracPackBody{std::move(trx)}));
+   }
+   while (t.runQueueItem())
+   {
+   }
+
+   // The first attempt to take the batch is discarded and retried. The
+   // retry must start from the same transaction instead of skipping the
+   // ones taken by the failed attempt.
+   tester::raw::failSubjectiveCommits(t.nativeHandle(), 1);
+   auto first = t.pushNextTransactions(2);
+   REQUIRE(first.size() == 2);
+   auto second = t.pushNextTransactions(2);
+   REQUIRE(second.size() == 1);
+   CHECK(t.pushNextTransactions(2).empty());
+
+   t.runAll();
+   for (auto& reply : replies)
+      CHECK(Result<void>(reply.get<TransactionTrace>()).succeeded());
+}
+
 TEST_CASE("Test stats")
 {
    DefaultTestChain t;
@@ -446,8 +446,9 @@ namespace SystemService
             std::string cspHeader =
                 getCspHeader(content, content->account, cspRootDomain(rootHost, request));
             auto etag = psio::hex(content->contentHash.data(), content->contentHash.data() + 8);
+            bool cache = useCache(content->account);
 
-            if (useCache(content->account) && shouldCache(request, etag))
+            if (cache && shouldCache(request, etag))
             {
                // https://issues.chromium.org/issues/40132719
                // Chrome bug - Devtools still shows 200 status code sometimes
@@ -524,6 +525,9 @@ namespace SystemService
                      {
                         reply.body = getUncompressedContent(reply.body, encoding);
                      }
+                     // Decompression runs another service, so psinode
+                     // cannot tell when this reply becomes stale.
+                     cache = false;
                   }
                }
             }
@@ -535,6 +539,14 @@ namespace SystemService
                }
             }
 
+            if (cache)
+            {
+               // The reply only depends on our tables and on the routing in http-server,
+               // so psinode may serve it again until either of them changes.
+               reply.headers.push_back(
+                   {"Psibase-Cache", Sites::service.str() + "," + HttpServer::service.str()});
+            }
+
             return reply;
          }
       }
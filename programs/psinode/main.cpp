@@ -3,12 +3,14 @@
 #include <psibase/Mount.hpp>
 #include <psibase/OpenSSLProver.hpp>
 #include <psibase/PKCS11Prover.hpp>
+#include <psibase/RecvThreadPool.hpp>
 #include <psibase/RunQueue.hpp>
 #include <psibase/TransactionContext.hpp>
 #include <psibase/http.hpp>
 #include <psibase/log.hpp>
 #include <psibase/node.hpp>
 #include <psibase/prefix.hpp>
+#include <psibase/response_cache.hpp>
 #include <psibase/serviceEntry.hpp>
 #include <psibase/version.hpp>
 #include <psio/finally.hpp>
@@ -213,6 +215,16 @@ std::string to_string(const Timeout& timeout)
    }
 }
 
+// The CPU time limit for queries. If it is not set explicitly,
+// it follows the time that clients have to send or receive a message.
+std::chrono::microseconds queryTimeout(const Timeout& http_query_timeout,
+                                       const Timeout& http_timeout)
+{
+   if (http_query_timeout != Timeout::none())
+      return http_query_timeout.duration;
+   return http_timeout.duration;
+}
+
 void to_json(const Timeout& obj, auto& stream)
 {
    if (obj != Timeout::none())
@@ -465,13 +477,32 @@ struct MemStats
 };
 PSIO_REFLECT(MemStats, database, code, data, wasmMemory, wasmCode, unclassified)
 
+struct HttpCacheStats
+{
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+   uint64_t entries;
+   uint64_t bytes;
+};
+PSIO_REFLECT(HttpCacheStats, hits, misses, evictions, entries, bytes)
+
+struct QueryTimeoutStats
+{
+   AccountNumber service;
+   uint64_t      count;
+};
+PSIO_REFLECT(QueryTimeoutStats, service, count)
+
 struct Perf
 {
-   std::int64_t            timestamp;
-   MemStats                memory;
-   std::vector<ThreadInfo> tasks;
+   std::int64_t                   timestamp;
+   MemStats                       memory;
+   std::vector<ThreadInfo>        tasks;
+   HttpCacheStats                 httpCache;
+   std::vector<QueryTimeoutStats> queryTimeouts;
 };
-PSIO_REFLECT(Perf, timestamp, memory, tasks)
+PSIO_REFLECT(Perf, timestamp, memory, tasks, httpCache, queryTimeouts)
 
 void write_om_descriptor(std::string_view name,
                          std::string_view type,
@@ -584,11 +615,50 @@ void write_om_tasks(const Perf& perf, auto& stream)
    }
 }
 
+void write_om_http_cache(const Perf& perf, auto& stream)
+{
+   const auto& cache = perf.httpCache;
+   write_om_descriptor("psinode_http_cache_hits", "counter", "", "HTTP Response Cache Hits",
+                       stream);
+   write_om_sample("psinode_http_cache_hits_total", std::to_string(cache.hits), stream);
+   write_om_descriptor("psinode_http_cache_misses", "counter", "", "HTTP Response Cache Misses",
+                       stream);
+   write_om_sample("psinode_http_cache_misses_total", std::to_string(cache.misses), stream);
+   write_om_descriptor("psinode_http_cache_evictions", "counter", "",
+                       "HTTP Response Cache Evictions", stream);
+   write_om_sample("psinode_http_cache_evictions_total", std::to_string(cache.evictions), stream);
+   write_om_descriptor("psinode_http_cache_entries", "gauge", "", "HTTP Response Cache Entries",
+                       stream);
+   write_om_sample("psinode_http_cache_entries", std::to_string(cache.entries), stream);
+   write_om_descriptor("psinode_http_cache_bytes", "gauge", "bytes", "HTTP Response Cache Size",
+                       stream);
+   write_om_sample("psinode_http_cache_bytes", std::to_string(cache.bytes), stream);
+}
+
+void write_om_query_timeouts(const Perf& perf, auto& stream)
+{
+   write_om_descriptor("psinode_http_query_timeouts", "counter", "",
+                       "HTTP Queries that Exceeded the CPU Time Limit", stream);
+   for (const auto& item : perf.queryTimeouts)
+   {
+      std::string_view name = "psinode_http_query_timeouts_total";
+      stream.write(name.data(), name.size());
+      stream.write("{service=", 9);
+      to_json(item.service.str(), stream);
+      stream.write("} ", 2);
+      auto value = std::to_string(item.count);
+      stream.write(value.data(), value.size());
+      stream.write('\n');
+   }
+}
+
 template <typename S>
 void to_openmetrics_text(const Perf& perf, S& stream)
 {
    write_om_mem(perf, stream);
    write_om_tasks(perf, stream);
+   write_om_http_cache(perf, stream);
+   write_om_query_timeouts(perf, stream);
    stream.write("# EOF\n", 6);
 }
 
@@ -851,7 +921,9 @@ MemStats getMemStats(const SharedState& state)
    return result;
 }
 
-Perf get_perf(const SharedState& state)
+Perf get_perf(const SharedState&                 state,
+              http::response_cache*              cache,
+              const http::query_timeout_counter& queryTimeouts)
 {
    long clk_tck = ::sysconf(_SC_CLK_TCK);
    Perf result;
@@ -863,6 +935,21 @@ Perf get_perf(const SharedState& state)
    {
       result.tasks.push_back(getThreadInfo(entry, clk_tck));
    }
+   if (cache)
+   {
+      auto stats       = cache->get_stats();
+      result.httpCache = {
+          .hits      = stats.hits,
+          .misses    = stats.misses,
+          .evictions = stats.evictions,
+          .entries   = stats.entries,
+          .bytes     = stats.bytes,
+      };
+   }
+   for (auto [service, count] : queryTimeouts.get())
+   {
+      result.queryTimeouts.push_back({service, count});
+   }
    return result;
 }
 
@@ -989,7 +1076,8 @@ struct PsinodeConfig
       constexpr std::string_view opts[] = {
           "producer", "pkcs11-modules",      "listen",       "tls-key",
           "tls-cert", "tls-trustfile",       "http-timeout", "service-threads",
-          "key",      "database-cache-size", "mount"};
+          "key",      "database-cache-size", "mount",       "http-cache-size",
+          "http-query-timeout", "state-checksum-cache"};
       return std::ranges::find(opts, name) != std::end(opts) || name.starts_with("logger.") ||
              name.starts_with("service.");
    }
@@ -1059,6 +1147,9 @@ void to_config(const PsinodeConfig& config, ConfigFile& file)
    // private keys.
    file.keep("", "key");
    file.keep("", "database-cache-size");
+   file.keep("", "http-cache-size");
+   file.keep("", "http-query-timeout");
+   file.keep("", "state-checksum-cache");
    file.keep("", "mount");
    //
    to_config(config.loggers, file);
@@ -1156,7 +1247,10 @@ void run(const std::string&              db_path,
          std::vector<listen_spec>        listen,
          std::vector<MountArg>&          mountpoints,
          Timeout&                        http_timeout,
+         Timeout                         http_query_timeout,
          std::size_t&                    service_threads,
+         byte_size                       http_cache_size,
+         bool                            state_checksum_cache,
          std::vector<std::string>        root_ca,
          std::string                     tls_cert,
          std::string                     tls_key,
@@ -1171,10 +1265,13 @@ void run(const std::string&              db_path,
            db_path,
            {db_conf.hot_bytes, db_conf.warm_bytes, db_conf.cool_bytes, db_conf.cold_bytes},
            triedent::open_mode::resize},
-       WasmCache{128});
+       WasmCache{128, db_path});
    auto system      = sharedState->getSystemContext();
    auto proofSystem = sharedState->getSystemContext();
 
+   if (state_checksum_cache)
+      system->sharedDatabase.enableKvMerkleCache();
+
    if (system->sharedDatabase.isSlow())
    {
       PSIBASE_LOG(psibase::loggers::generic::get(), warning)
@@ -1242,6 +1339,10 @@ void run(const std::string&              db_path,
    // If this is a new database, initialize subjective services
    initialize_database(*system, db_template);
 
+   // Recompile the services that were in use before the last shutdown in
+   // the background, so that the first blocks are less likely to wait for them.
+   system->wasmCache.preload(system->sharedDatabase);
+
    // Manages the session and and unlinks all keys from prover on destruction
    struct PKCS11SessionManager
    {
@@ -1390,6 +1491,8 @@ void run(const std::string&              db_path,
    node_type node(chainContext, system.get(), prover);
    node.set_producer_id(producer);
    node.load_producers();
+   // Keep consensus messages flowing while catching up on a long fork
+   node.chain().setForkSwitchTimeSlice(std::chrono::milliseconds(100));
 
    // The callback is *not* posted to chainContext. It can run concurrently.
    node.chain().onChangeRunQueue([&] { runQueue.notify(); });
@@ -1398,6 +1501,10 @@ void run(const std::string&              db_path,
    // but we can't safely start any threads until after all the node state
    // is initialized.
    WasmThreadPool tpool{runQueue, 0};
+   // Handles messages that services receive from other producers off the chain thread
+   RecvThreadPool recvPool{sharedState, 0};
+   node.chain().setRecvThreadPool(&recvPool);
+   node.chain().setSharedState(sharedState);
 
    ShutdownTimer shutdownTimer;
 
@@ -1411,14 +1518,15 @@ void run(const std::string&              db_path,
           auto config = psio::convert_from_json<PsinodeConfig>(view.config().unpack());
        });
    node.chain().onChangeHostConfig(
-       [&chainContext, &node, &db_path, &runResult, &http_config, &http_timeout, &service_threads,
-        &tpool, &tls_cert, &tls_key, &root_ca, &pkcs11_modules, &system, setPKCS11Libs]
+       [&chainContext, &node, &db_path, &runResult, &http_config, &http_timeout,
+        &http_query_timeout, &service_threads, &tpool, &recvPool, &tls_cert, &tls_key, &root_ca,
+        &pkcs11_modules, &system, setPKCS11Libs]
        {
           boost::asio::post(
               chainContext,
               [&chainContext, &node, &db_path, &runResult, &http_config, &http_timeout,
-               &service_threads, &tpool, &tls_cert, &tls_key, &root_ca, &pkcs11_modules, &system,
-               setPKCS11Libs]
+               &http_query_timeout, &service_threads, &tpool, &recvPool, &tls_cert, &tls_key,
+               &root_ca, &pkcs11_modules, &system, setPKCS11Libs]
               {
                  auto writer = system->sharedDatabase.createWriter();
                  auto row    = system->sharedDatabase.kvGetSubjective(
@@ -1443,8 +1551,14 @@ void run(const std::string&              db_path,
                     std::lock_guard l{http_config->mutex};
                     http_config->listen          = config.listen;
                     http_config->idle_timeout_us = http_timeout.duration.count();
+                    http_config->query_timeout_us =
+                        queryTimeout(http_query_timeout, http_timeout).count();
                  }
+                 // Cached replies may depend on the host names
+                 if (http_config->reply_cache)
+                    http_config->reply_cache->clear();
                  tpool.setNumThreads(service_threads);
+                 recvPool.setNumThreads(std::max(service_threads, std::size_t{1}));
                  {
                     auto       path = std::filesystem::path(db_path) / "config";
                     ConfigFile file{config_options};
@@ -1495,9 +1609,10 @@ void run(const std::string&              db_path,
        });
 
    auto stop_threads =
-       psio::finally{[&chainContext, &tpool]
+       psio::finally{[&chainContext, &tpool, &recvPool]
                      {
                         tpool.setNumThreads(0);
+                        recvPool.setNumThreads(0);
                         auto& ectx = static_cast<boost::asio::execution_context&>(chainContext);
                         if (boost::asio::has_service<http::server_service>(ectx))
                            boost::asio::use_service<http::server_service>(ectx).stop();
@@ -1509,9 +1624,12 @@ void run(const std::string&              db_path,
       http_config->num_threads      = 4;
       http_config->max_request_size = 20 * 1024 * 1024;
       http_config->idle_timeout_us  = http_timeout.duration.count();
+      http_config->query_timeout_us = queryTimeout(http_query_timeout, http_timeout).count();
       http_config->listen           = listen;
       http_config->status           = http::http_status{
           .slow = system->sharedDatabase.isSlow(), .startup = 1, .needgenesis = 1};
+      if (http_cache_size.value != 0)
+         http_config->reply_cache = std::make_shared<http::response_cache>(http_cache_size.value);
 
       // TODO: speculative execution on non-producers
       http_config->push_boot_async =
@@ -1538,10 +1656,12 @@ void run(const std::string&              db_path,
                            });
       };
 
-      http_config->get_perf = [sharedState](auto callback)
+      // http_config owns these callbacks, so they must not hold a shared_ptr to it
+      http_config->get_perf = [sharedState, cache = http_config->reply_cache,
+                               queryTimeouts = &http_config->query_timeouts](auto callback)
       {
          callback(
-             [result = get_perf(*sharedState)]() mutable
+             [result = get_perf(*sharedState, cache.get(), *queryTimeouts)]() mutable
              {
                 std::vector<char>   json;
                 psio::vector_stream stream(json);
@@ -1550,10 +1670,11 @@ void run(const std::string&              db_path,
              });
       };
 
-      http_config->get_metrics = [sharedState](auto callback)
+      http_config->get_metrics = [sharedState, cache = http_config->reply_cache,
+                                  queryTimeouts = &http_config->query_timeouts](auto callback)
       {
          callback(
-             [result = get_perf(*sharedState)]() mutable
+             [result = get_perf(*sharedState, cache.get(), *queryTimeouts)]() mutable
              {
                 std::vector<char>   data;
                 psio::vector_stream stream(data);
@@ -1787,6 +1908,24 @@ void run(const std::string&              db_path,
                            });
       };
 
+      http_config->prewarm = [sharedDatabase = system->sharedDatabase,
+                              wasmCache      = system->wasmCache](std::vector<char> json,
+                                                                  auto callback) mutable
+      {
+         try
+         {
+            json.push_back('\0');
+            psio::json_token_stream stream(json.data());
+            auto services = psio::from_json<std::vector<AccountNumber>>(stream);
+            wasmCache.prepareServices(sharedDatabase, services);
+            callback(std::nullopt);
+         }
+         catch (std::exception& e)
+         {
+            callback(e.what());
+         }
+      };
+
       auto& service =
           boost::asio::make_service<http::server_service>(chainContext, http_config, sharedState);
       node.chain().onSocketOpen(service.get_connector());
@@ -1821,6 +1960,8 @@ void run(const std::string&              db_path,
    }
 
    tpool.setNumThreads(service_threads);
+   // Messages must be handled even if async actions are disabled
+   recvPool.setNumThreads(std::max(service_threads, std::size_t{1}));
 
    node.set_producer_id(producer);
    {
@@ -1853,6 +1994,9 @@ int main(int argc, char* argv[])
    byte_size                db_cache_size;
    byte_size                db_size;
    Timeout                  http_timeout;
+   Timeout                  http_query_timeout;
+   byte_size                http_cache_size;
+   bool                     state_checksum_cache;
    std::size_t              service_threads;
    PsinodeServiceConfig     extra_options;
 
@@ -1893,8 +2037,18 @@ int main(int argc, char* argv[])
        "Path to a PKCS #11 module to load");
    opt("http-timeout", po::value(&http_timeout)->default_value({}, "")->value_name("seconds"),
        "The maximum time for HTTP clients to send or receive a message");
+   opt("http-query-timeout",
+       po::value(&http_query_timeout)->default_value({}, "")->value_name("seconds"),
+       "The maximum CPU time that an HTTP query may use. Defaults to --http-timeout.");
    opt("service-threads", po::value(&service_threads)->default_value(1, "")->value_name("num"),
        "The number of threads that run async actions posted by services");
+   opt("http-cache-size",
+       po::value(&http_cache_size)->default_value({std::size_t(1) << 26}, "64 MiB"),
+       "The amount of RAM used to cache HTTP replies that services mark as reusable. 0 disables "
+       "the cache.");
+   opt("state-checksum-cache", po::bool_switch(&state_checksum_cache),
+       "Keeps the hashes used by the previous state checksum, so that the next one only hashes "
+       "the parts of the state that changed. This uses additional memory.");
    desc.add(common_opts);
    opt = desc.add_options();
    // These should be usable on the command line and shown in help
@@ -1997,8 +2151,9 @@ int main(int argc, char* argv[])
       {
          restart.args.reset();
          run(db_path, db_template, DbConfig{db_cache_size}, AccountNumber{producer}, keys,
-             pkcs11_modules, listen, mountpoints, http_timeout, service_threads, root_ca, tls_cert,
-             tls_key, extra_options, restart);
+             pkcs11_modules, listen, mountpoints, http_timeout, http_query_timeout,
+             service_threads, http_cache_size, state_checksum_cache, root_ca, tls_cert, tls_key,
+             extra_options, restart);
          if (!restart.args || !restart.args->restart)
          {
             PSIBASE_LOG(psibase::loggers::generic::get(), info) << "Shutdown";
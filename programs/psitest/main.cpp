@@ -1653,6 +1653,38 @@ struct callbacks
       chain.database().kvRemoveRaw(getDbWrite(chain, db).db, {key.data(), key.size()});
    }
 
+   void kvReplaceRange(std::uint32_t               chain_index,
+                       uint32_t                    db,
+                       eosio::vm::span<const char> low,
+                       eosio::vm::span<const char> high,
+                       eosio::vm::span<const char> rows)
+   {
+      auto& chain = assert_chain(chain_index);
+      state.result_key.clear();
+      state.result_value.clear();
+      psio::input_stream in{rows.data(), rows.size()};
+      auto               next = [&]
+      {
+         std::uint32_t size;
+         psibase::check(in.remaining() >= sizeof(size), "kvReplaceRange: truncated row");
+         std::memcpy(&size, in.pos, sizeof(size));
+         in.pos += sizeof(size);
+         psibase::check(in.remaining() >= size, "kvReplaceRange: truncated row");
+         psio::input_stream result{in.pos, size};
+         in.pos += size;
+         return result;
+      };
+      std::vector<psibase::Database::KVResult> parsed;
+      while (in.remaining())
+      {
+         auto key   = next();
+         auto value = next();
+         parsed.push_back({key, value});
+      }
+      chain.database().kvReplaceRangeRaw(getDbWrite(chain, db).db, {low.data(), low.size()},
+                                         {high.data(), high.size()}, parsed);
+   }
+
    void checkoutSubjective(std::uint32_t chain_index)
    {
       assert_chain(chain_index).native().checkoutSubjective();
@@ -1665,6 +1697,10 @@ struct callbacks
    {
       assert_chain(chain_index).native().abortSubjective();
    }
+   void failSubjectiveCommits(std::uint32_t chain_index, std::uint32_t count)
+   {
+      assert_chain(chain_index).db.failSubjectiveCommits(count);
+   }
 
    void commitState(std::uint32_t chain_index) { assert_chain(chain_index).writeRevision(); }
 
@@ -1697,6 +1733,7 @@ void register_callbacks()
    rhf_t::add<&callbacks::kvMax>("psibase", "kvMax");
    rhf_t::add<&callbacks::kvPut>("psibase", "kvPut");
    rhf_t::add<&callbacks::kvRemove>("psibase", "kvRemove");
+   rhf_t::add<&callbacks::kvReplaceRange>("psibase", "kvReplaceRange");
    rhf_t::add<&callbacks::kvGetTransactionUsage>("psibase", "kvGetTransactionUsage");
 
    // Tester Intrinsics
@@ -1711,6 +1748,7 @@ void register_callbacks()
    rhf_t::add<&callbacks::checkoutSubjective>("psibase", "checkoutSubjective");
    rhf_t::add<&callbacks::commitSubjective>("psibase", "commitSubjective");
    rhf_t::add<&callbacks::abortSubjective>("psibase", "abortSubjective");
+   rhf_t::add<&callbacks::failSubjectiveCommits>("psibase", "failSubjectiveCommits");
    rhf_t::add<&callbacks::commitState>("psibase", "commitState");
    rhf_t::add<&callbacks::testerRunAction>("psibase", "runAction");
    rhf_t::add<&callbacks::testerPushTransaction>("psibase", "pushTransaction");
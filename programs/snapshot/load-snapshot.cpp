@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <span>
 #include <vector>
 
 #include <psibase/KvMerkle.hpp>
@@ -278,6 +279,51 @@ int verifySignatures(std::uint32_t                  authServices,
    return result;
 }
 
+// The service and native databases are empty while the snapshot is loaded,
+// and their rows arrive in key order, so they are written in batches with
+// kvReplaceRange instead of one kvPut per row.
+struct RowBatch
+{
+   static constexpr std::size_t maxBytes = 16 * 1024 * 1024;
+
+   std::uint32_t     chain;
+   DbId              db = {};
+   std::vector<char> low;
+   std::vector<char> last;
+   std::vector<char> rows;
+
+   void push(DbId rowDb, std::span<const char> key, std::span<const char> value)
+   {
+      if (rowDb != db || rows.size() >= maxBytes)
+         flush();
+      if (rows.empty())
+      {
+         db = rowDb;
+         low.assign(key.begin(), key.end());
+      }
+      last.assign(key.begin(), key.end());
+      append(key);
+      append(value);
+   }
+   void flush()
+   {
+      if (rows.empty())
+         return;
+      // The range ends at the smallest key that is greater than the last row
+      last.push_back(0);
+      raw::kvReplaceRange(chain, db, low.data(), low.size(), last.data(), last.size(),
+                          rows.data(), rows.size());
+      rows.clear();
+   }
+   void append(std::span<const char> data)
+   {
+      std::uint32_t size = data.size();
+      rows.insert(rows.end(), reinterpret_cast<const char*>(&size),
+                  reinterpret_cast<const char*>(&size) + sizeof(size));
+      rows.insert(rows.end(), data.begin(), data.end());
+   }
+};
+
 int read(std::uint32_t          chain,
          auto&                  stream,
          SnapshotFooter&        footer,
@@ -288,6 +334,7 @@ int read(std::uint32_t          chain,
    KvMerkle::Item item;
    std::uint32_t  current_db = 0;
    KvMerkle       merkle;
+   RowBatch       batch{chain};
    while (read_u32(db, stream))
    {
       switch (db)
@@ -364,10 +411,10 @@ int read(std::uint32_t          chain,
       else
       {
          merkle.push(item);
-         raw::kvPut(chain, static_cast<DbId>(db), key.data(), key.size(), value.data(),
-                    value.size());
+         batch.push(static_cast<DbId>(db), key, value);
       }
    }
+   batch.flush();
    return 0;
 }
 
@@ -461,17 +508,7 @@ void writeLogTruncateRow(psibase::ChainHandle         chain,
 
 void clearDb(std::uint32_t chain, DbId db)
 {
-   std::vector<char> key;
-   while (true)
-   {
-      std::uint32_t value_size = raw::kvGreaterEqual(chain, db, key.data(), key.size(), 0);
-      if (value_size == 0xffffffffu)
-         return;
-      std::uint32_t key_size = raw::getKey(nullptr, 0);
-      key.resize(key_size);
-      raw::getKey(key.data(), key_size);
-      raw::kvRemove(chain, db, key.data(), key.size());
-   }
+   raw::kvReplaceRange(chain, db, nullptr, 0, nullptr, 0, nullptr, 0);
 }
 
 using input_stream = boost::iostreams::filtering_stream<boost::iostreams::input>;